@@ -69,8 +69,8 @@ void mainApp(void)
     while(ps2_mouse_getmove(&MouseData) == 1)
     #endif
     { /* recevied mouse data */
-      if((prebtn != MouseData.btns) || (MouseData.xmove != 0) || (MouseData.ymove != 0) || (MouseData.zmove != 0))
-        printf("mouse:%d, %d, %d, %X\r\n", MouseData.xmove, MouseData.ymove, MouseData.zmove, MouseData.btns);
+      if((prebtn != MouseData.btns) || (MouseData.xmove != 0) || (MouseData.ymove != 0) || (MouseData.zmove != 0) || (MouseData.wmove != 0))
+        printf("mouse:%d, %d, %d, %d, %X\r\n", (int)MouseData.xmove, (int)MouseData.ymove, MouseData.zmove, MouseData.wmove, MouseData.btns);
       prebtn = MouseData.btns;
     }
   }
@@ -105,6 +105,34 @@
 #error KBDTBUF SIZE is not equal to 2 ^ n
 #endif
 
+#if KBDKBUF_SIZE < 2
+#error KBDKBUF SIZE too small
+#elif ((KBDKBUF_SIZE & (KBDKBUF_SIZE-1)) != 0)
+#error KBDKBUF SIZE is not equal to 2 ^ n
+#endif
+
+#if KBD_SCANNER >= 1
+#if KBD_RXDECODE == 0
+#error KBD_SCANNER needs KBD_RXDECODE 1
+#elif (KBD_SCANNER == 2) && (KBD_SCANNER_TIMEOUT == 0)
+#error KBD_SCANNER 2 needs KBD_SCANNER_TIMEOUT
+#elif KBD_SCANNER_BUFSIZE <= KBD_SCANNER_MAXLEN
+#error KBD_SCANNER_BUFSIZE too small
+#elif ((KBD_SCANNER_BUFSIZE & (KBD_SCANNER_BUFSIZE-1)) != 0)
+#error KBD_SCANNER_BUFSIZE is not equal to 2 ^ n
+#endif
+#endif
+
+#if KBD_MAGSTRIPE == 1
+#if KBD_RXDECODE == 0
+#error KBD_MAGSTRIPE needs KBD_RXDECODE 1
+#elif KBD_SCANNER >= 1
+#error KBD_MAGSTRIPE and KBD_SCANNER are not possible together
+#elif KBD_MAGSTRIPE_TIMEOUT == 0
+#error KBD_MAGSTRIPE needs KBD_MAGSTRIPE_TIMEOUT
+#endif
+#endif
+
 #endif
 
 // ----------------------------------------------------------------------------
@@ -214,18 +242,39 @@ static inline void ps2_initcheck(void)
 #if  PS2_KBD_EXT_N >= 1
 
 volatile uint8_t  ps2_kbdlockstatus;    /* the lock and led bits: 0,0,0,0,0,capslock,numlock,scrollock */
-volatile uint8_t  ps2_kbdctrlstatus;
 
 void     cb_ps2_kbdrx(uint8_t rxdata, uint8_t error);
 uint8_t  cb_ps2_kbdtx(uint8_t * txdata);
+static uint8_t ps2_kbd_decode(uint8_t scan, ps2_KbdEvent * kbd_event);
+#if KBD_HOTPLUG == 1
+static void ps2_kbd_keyreset(void);
+#endif
+static inline void ps2_kbd_evchar(ps2_KbdEvent * kbd_event);
 
+#if KBD_RXDECODE == 0
+struct kbdbuf_r
+{
+  uint32_t in;                /* Next In Index */
+  uint32_t out;               /* Next Out Index */
+  char data[KBDRBUF_SIZE];    /* Buffer data (scan codes) */
+};
+#elif KBD_RXDECODE == 1
 struct kbdbuf_r
 {
   uint32_t in;                /* Next In Index */
   uint32_t out;               /* Next Out Index */
-  char data[KBDRBUF_SIZE];    /* Buffer data */
+  uint16_t data[KBDRBUF_SIZE];/* Buffer data (packed key events) */
 };
 
+/* packed key event (16 bits): usage, type, modifiers, capslock and numlock status
+   - bit 0..7: usage, bit 8..9: type, bit 10..13: mods, bit 14: numlock, bit 15: capslock */
+#define KEV_PACK(ev)      ((uint16_t)((ev).usage | ((ev).type << 8) | ((ev).mods << 10) | (((ev).locks & (ST_KBDNUMLOCK | ST_KBDCAPSLOCK)) << 13)))
+#define KEV_USAGE(kev)    ((uint8_t)(kev))
+#define KEV_TYPE(kev)     (((kev) >> 8) & 0x03)
+#define KEV_MODS(kev)     (((kev) >> 10) & 0x0F)
+#define KEV_LOCKS(kev)    (((kev) >> 13) & (ST_KBDNUMLOCK | ST_KBDCAPSLOCK))
+#endif
+
 struct kbdbuf_t
 {
   uint32_t in;                /* Next In Index */
@@ -241,514 +290,1498 @@ volatile uint8_t  kbd_rx_error = 0;
 
 __weak  void ps2_kbd_cbrx(uint8_t rx_data) { }
 __weak  void ps2_kbd_cbrxerror(uint32_t rx_errorcode) { }
+__weak  void ps2_kbd_cbstatus(uint8_t kbd_mods, uint8_t kbd_locks) { }
 
+#if KBD_RXDECODE == 1
 // ----------------------------------------------------------------------------
-uint8_t ps2_kbd_datawrite(uint8_t kbd_data)
+/* packed key event -> RX fifo buffer */
+static void ps2_kbd_evstore(uint16_t kev)
 {
-  if(FIFO_FULL(kbdtbuf, KBDTBUF_SIZE))
-    return 0;
-
-  FIFO_WRITE(kbdtbuf, KBDTBUF_SIZE, kbd_data);  /* Add data to the transmit buffer. */
-  ps2_printf("kt:%X\r\n", (unsigned int)kbd_data);
-
-  if(kbd.status == PASSIVE)             /* can I send now? */
+  if(FIFO_NOTFULL(kbdrbuf, KBDRBUF_SIZE))
   {
-    GPIOX_CLR(PS2_KBDCLK);              /* CLK = 0 */
-    TIM_RESTART;
-    PS2_KBDTIM_ON;                      /* Timer active */
-    kbd.status = SENDSTART;
-    ps2_printf("kts\r\n");
+    FIFO_WRITE(kbdrbuf, KBDRBUF_SIZE, kev);
+    ps2_printf("kcr:%X\r\n", (unsigned int)kev);
+  }
+  else
+  {
+    ps2_kbd_cbrxerror(PS2_ERROR_OVF);
+    ps2_printf("kcr:full!!\r\n");
   }
-  return 1;
 }
+#endif
 
+#if KBD_SCANNER >= 1
 // ----------------------------------------------------------------------------
-uint8_t ps2_kbd_dataread(uint8_t * kbd_data)
+/* barcode scanner string assembly (keyboard RX interrupt) */
+struct scanbuf_r
 {
-  if(FIFO_NOTEMPTY(kbdrbuf))
-  { /* not empty */
-    FIFO_READ(kbdrbuf, KBDRBUF_SIZE, *kbd_data);
-    ps2_printf("kr:%X\r\n", (unsigned int)*kbd_data);
-    return 1;
+  uint32_t in;                /* Next In Index */
+  uint32_t out;               /* Next Out Index */
+  uint8_t data[KBD_SCANNER_BUFSIZE]; /* Buffer data (completed strings with 0 terminator) */
+};
+
+static struct scanbuf_r scanbuf = {0, 0,};
+uint8_t  ps2_kbd_scanstage[KBD_SCANNER_MAXLEN + 1]; /* the string under assembly */
+uint32_t ps2_kbd_scanlen = 0;           /* the string under assembly length */
+uint32_t ps2_kbd_scantime;              /* last character time (ms) */
+#if KBD_SCANNER == 1
+uint32_t ps2_kbd_scankeys[8];           /* the keys used by the scanner (bit n = HID usage n, the release is dropped) */
+#elif KBD_SCANNER == 2
+uint16_t ps2_kbd_scanhold[KBD_SCANNER_HOLD]; /* held key events (packed) until the classification */
+uint32_t ps2_kbd_scanholdn = 0;         /* held key events number */
+uint8_t  ps2_kbd_scanrun = 0;           /* 0 = no run, 1 = the run is not classified yet, 2 = scanner run */
+#endif
+
+__weak  void ps2_kbd_cbstring(uint8_t * str, uint32_t len) { }
+
+// ----------------------------------------------------------------------------
+/* the string under assembly is complete -> completed strings buffer + callback
+   (if the whole string does not fit in the buffer, it is dropped) */
+static void ps2_kbd_scanend(void)
+{
+  uint32_t i;
+  if(ps2_kbd_scanlen == 0)
+    return;
+  ps2_kbd_scanstage[ps2_kbd_scanlen] = 0;
+  if(KBD_SCANNER_BUFSIZE - FIFO_LEN(scanbuf) > ps2_kbd_scanlen)
+  {
+    for(i = 0; i <= ps2_kbd_scanlen; i++)
+      FIFO_WRITE(scanbuf, KBD_SCANNER_BUFSIZE, ps2_kbd_scanstage[i]);
   }
   else
-  { /* empty */
-    return 0;
+  {
+    ps2_kbd_cbrxerror(PS2_ERROR_OVF);
+    ps2_printf("kcs:full!!\r\n");
   }
+  ps2_kbd_cbstring(ps2_kbd_scanstage, ps2_kbd_scanlen);
+  ps2_kbd_scanlen = 0;
 }
 
+#if KBD_SCANNER == 1
 // ----------------------------------------------------------------------------
-/* PS2 keyboard tx data get from tx fifo buffer (if txdata == NULL -> only tx buffer data info) */
-uint8_t cb_ps2_kbdtx(uint8_t * txdata)
+/* one character to the string under assembly */
+static void ps2_kbd_scanchar(uint8_t ch)
 {
-  if(FIFO_NOTEMPTY(kbdtbuf))
+  uint32_t t = PS2_GETTIME();
+  #if KBD_SCANNER_TIMEOUT > 0
+  if(ps2_kbd_scanlen && (t - ps2_kbd_scantime > KBD_SCANNER_TIMEOUT))
+    ps2_kbd_scanend();                  /* inter character timeout: the previous string is complete */
+  #endif
+  ps2_kbd_scantime = t;
+  if((ch == KBD_SCANNER_TERM1) || (ch == KBD_SCANNER_TERM2))
+    ps2_kbd_scanend();
+  else if(ps2_kbd_scanlen < KBD_SCANNER_MAXLEN)
+    ps2_kbd_scanstage[ps2_kbd_scanlen++] = ch;
+}
+
+// ----------------------------------------------------------------------------
+/* inter character timeout check (interrupt or IRQ disabled) */
+static inline void ps2_kbd_scanpoll(void)
+{
+  #if KBD_SCANNER_TIMEOUT > 0
+  if(ps2_kbd_scanlen && (PS2_GETTIME() - ps2_kbd_scantime > KBD_SCANNER_TIMEOUT))
+    ps2_kbd_scanend();
+  #endif
+}
+
+// ----------------------------------------------------------------------------
+/* key event -> barcode string
+   - the characters -> string, the release of these keys is dropped
+   - the modifier keys inside the string (press and release) are dropped
+   - return: 0 = the key event is not used (-> RX fifo), 1 = used */
+static uint8_t ps2_kbd_scankey(ps2_KbdEvent * kbd_event)
+{
+  uint32_t * keys = &ps2_kbd_scankeys[kbd_event->usage >> 5];
+  uint32_t bit = 1UL << (kbd_event->usage & 0x1F);
+
+  ps2_kbd_scanpoll();                   /* the previous string is complete? */
+  if(kbd_event->type == PS2_KEV_BREAK)
   {
-    if(txdata)
-    {
-      FIFO_READ(kbdtbuf, KBDTBUF_SIZE, *txdata);
-      ps2_printf("kct:%X\r\n", (unsigned int)*txdata);
-    }
+    if(!(*keys & bit))
+      return 0;
+    *keys &= ~bit;
     return 1;
   }
-  else
-    return 0;
+  if(kbd_event->ch)
+    ps2_kbd_scanchar(kbd_event->ch);    /* character -> barcode string */
+  else if((kbd_event->type != PS2_KEV_MAKE) || (kbd_event->usage < PS2_HID_LCTRL) || !ps2_kbd_scanlen)
+    return 0;                           /* not character, not modifier inside the string */
+  *keys |= bit;
+  return 1;
 }
 
+#elif KBD_SCANNER == 2
 // ----------------------------------------------------------------------------
-/* PS2 keyboard rx data store to rx fifo buffer */
-void cb_ps2_kbdrx(uint8_t rxdata, uint8_t error)
+/* end of the run: scanner run -> string, not classified run -> the held key events to the RX fifo (human) */
+static void ps2_kbd_scanflush(void)
 {
-  static uint8_t predata = 0;
-  if(error)
+  uint32_t i;
+  if(ps2_kbd_scanrun == 2)
+    ps2_kbd_scanend();
+  else
   {
-    kbd_rx_error = 1;
+    for(i = 0; i < ps2_kbd_scanholdn; i++)
+      ps2_kbd_evstore(ps2_kbd_scanhold[i]);
   }
+  ps2_kbd_scanlen = 0;
+  ps2_kbd_scanholdn = 0;
+  ps2_kbd_scanrun = 0;
+}
 
-  if(FIFO_NOTFULL(kbdrbuf, KBDRBUF_SIZE))
+// ----------------------------------------------------------------------------
+/* key event classification (human or scanner)
+   - the run starts with a character or modifier key press, the key events are held until the classification
+   - scanner: KBD_SCANNER_MINBURST characters with less inter key time than KBD_SCANNER_TIMEOUT
+     (the characters -> string, the other key events of the scanner are dropped until the end of the run)
+   - human: the inter key time is more than KBD_SCANNER_TIMEOUT (or the terminator or the hold buffer is full)
+     (the held key events -> RX fifo)
+   - return: 0 = the key event is not used (-> RX fifo), 1 = held or scanner */
+static uint8_t ps2_kbd_scanclass(ps2_KbdEvent * kbd_event)
+{
+  uint32_t t = PS2_GETTIME();
+  uint8_t ch = (kbd_event->type == PS2_KEV_MAKE) ? kbd_event->ch : 0;
+
+  if(ps2_kbd_scanrun && (t - ps2_kbd_scantime > KBD_SCANNER_TIMEOUT))
+    ps2_kbd_scanflush();                /* end of the run */
+  if(!ps2_kbd_scanrun)
   {
-    FIFO_WRITE(kbdrbuf, KBDRBUF_SIZE, rxdata);
-    ps2_printf("kcr:%X\r\n", (unsigned int)rxdata);
+    if((ch == 0) && ((kbd_event->type != PS2_KEV_MAKE) || (kbd_event->usage < PS2_HID_LCTRL)))
+      return 0;                         /* no run */
+    ps2_kbd_scanrun = 1;                /* run start */
   }
-  else
-  {
-    ps2_kbd_cbrxerror(PS2_ERROR_OVF);
-    ps2_printf("kcr:full!!\r\n");
+  ps2_kbd_scantime = t;
+
+  if(ps2_kbd_scanrun == 2)
+  { /* scanner run */
+    if((ch == KBD_SCANNER_TERM1) || (ch == KBD_SCANNER_TERM2))
+      ps2_kbd_scanend();
+    else if(ch && (ps2_kbd_scanlen < KBD_SCANNER_MAXLEN))
+      ps2_kbd_scanstage[ps2_kbd_scanlen++] = ch;
+    return 1;
   }
 
-  if((predata != 0xF0) && (rxdata != 0xFA))
-  { /* LED change */
-    if(rxdata == SCN_CAPSLOCK)
-    { /* capslock */
-      ps2_kbdlockstatus ^= ST_KBDCAPSLOCK;
-    }
-    else if(rxdata == SCN_NUMLOCK)
-    { /* numlock */
-      ps2_kbdlockstatus ^= ST_KBDNUMLOCK;
-    }
-    else if(rxdata == SCN_SCRLOCK)
-    { /* scrlock */
-      ps2_kbdlockstatus ^= ST_KBDSCRLOCK;
-    }
-    else
-    {
-      predata = rxdata;
-      return;
+  /* not classified run */
+  if(ps2_kbd_scanholdn >= KBD_SCANNER_HOLD)
+  { /* the hold buffer is full: human */
+    ps2_kbd_scanflush();
+    return 0;
+  }
+  ps2_kbd_scanhold[ps2_kbd_scanholdn++] = KEV_PACK(*kbd_event);
+  if((ch == KBD_SCANNER_TERM1) || (ch == KBD_SCANNER_TERM2))
+    ps2_kbd_scanflush();                /* short run with terminator: human */
+  else if(ch)
+  {
+    ps2_kbd_scanstage[ps2_kbd_scanlen++] = ch;
+    if(ps2_kbd_scanlen >= KBD_SCANNER_MINBURST)
+    { /* fast burst: scanner (the held key events are dropped) */
+      ps2_kbd_scanrun = 2;
+      ps2_kbd_scanholdn = 0;
     }
-    ps2_printf("key lock:%X\r\n", (unsigned int)ps2_kbdlockstatus);
-    ps2_kbd_datawrite(0xED);
-    ps2_kbd_datawrite(ps2_kbdlockstatus);
   }
-  predata = rxdata;
-  ps2_kbd_cbrx(rxdata);
+  return 1;
 }
 
-
 // ----------------------------------------------------------------------------
-/* low level ps2 keyboard init */
-static inline void ps2_kbdinit(void)
+/* end of the run check (interrupt or IRQ disabled) */
+static inline void ps2_kbd_scanpoll(void)
 {
-  GPIOX_SET(PS2_KBDCLK);                /* CLK = 1 */
-  GPIOX_ODOUT(PS2_KBDCLK);              /* CLK = OD out */
-
-  GPIOX_SET(PS2_KBDDATA);               /* DATA = 1 */
-  GPIOX_ODOUT(PS2_KBDDATA);             /* DATA = OD out */
-
-  EXTI_INIT(PS2_KBDCLK);
-
-  kbd.clockport = GPIOX(PS2_KBDCLK);
-  kbd.dataport  = GPIOX(PS2_KBDDATA);
-  kbd.clockpinmask = 1 << (GPIOX_PIN(PS2_KBDCLK));
-  kbd.datapinmask = 1 << (GPIOX_PIN(PS2_KBDDATA));
-
-  NVIC->ISER[(((uint32_t)(int32_t)PS2_KBD_EXT_IRQ) >> 5UL)] = (uint32_t)(1UL << (((uint32_t)(int32_t)PS2_KBD_EXT_IRQ) & 0x1FUL));
-  NVIC->IP[((uint32_t)(int32_t)PS2_KBD_EXT_IRQ)] = (uint8_t)((PS2_IRQPRIORITY << (8U - __NVIC_PRIO_BITS)) & (uint32_t)0xFFUL);
+  if(ps2_kbd_scanrun && (PS2_GETTIME() - ps2_kbd_scantime > KBD_SCANNER_TIMEOUT))
+    ps2_kbd_scanflush();
 }
+#endif
+#endif
 
-#endif  // #if  PS2_KBD_EXT_N >= 1
-
+#if KBD_MAGSTRIPE == 1
 // ----------------------------------------------------------------------------
-/* mouse low level */
-#if  PS2_MOUSE_EXT_N >= 1
-
-struct mousebuf_r
-{
-  volatile unsigned int in;             /* Next In Index */
-  volatile unsigned int out;            /* Next Out Index */
-  char data[MOUSERBUF_SIZE];            /* Buffer */
-};
+/* magnetic stripe card reader track capture (keyboard RX interrupt)
+   - track 1: % data ? [LRC], track 2: ; data ? [LRC], track 3: + data ? [LRC] or the second ; data ? [LRC] */
+#define  MAG_IDLE             0         /* no card */
+#define  MAG_START            1         /* start sentinel held (human or card: the next character decides) */
+#define  MAG_DATA             2         /* track data */
+#define  MAG_LRC              3         /* after the end sentinel (LRC, next track, enter) */
+#define  MAG_END              4         /* after the LRC (next track, enter) */
+#define  MAG_HOLD            16         /* held key events (until the first end sentinel) */
+#define  MAG_NOTRACK       0xFF         /* no start sentinel yet */
+#define  MAG_SENTINEL(ch)  (((ch) == '%') || ((ch) == ';') || ((ch) == '+'))
+
+ps2_KbdCard ps2_kbd_magstage;           /* the card under capture */
+ps2_KbdCard ps2_kbd_magcard;            /* the completed card */
+volatile uint8_t ps2_kbd_magready = 0;  /* 1 = ps2_kbd_magcard is completed and not yet read */
+uint8_t  ps2_kbd_magstate = MAG_IDLE;
+uint8_t  ps2_kbd_magtrack;              /* the actual track (0..2) */
+uint8_t  ps2_kbd_maglrc;                /* the actual track LRC */
+uint32_t ps2_kbd_magtime;               /* last character time (ms) */
+uint16_t ps2_kbd_maghold[MAG_HOLD];     /* held key events (packed, MAG_START) */
+uint8_t  ps2_kbd_magholdn = 0;          /* MAG_HOLD + 1: the held events are overflowed */
+uint8_t  ps2_kbd_magframed;             /* 1 = the card has an end sentinel (the held events are dropped) */
+uint8_t  ps2_kbd_magdrop = 0;           /* the release of this key is dropped (the card end enter) */
+
+__weak  void ps2_kbd_cbcard(ps2_KbdCard * card) { }
+
+/* track character value (track 1: 6 bits from the space, track 2 and 3: 4 bits from '0') */
+#define  MAG_VALUE(track, ch)  ((track) ? (((ch) - '0') & 0x0F) : (((ch) - ' ') & 0x3F))
 
-struct mousebuf_t
+// ----------------------------------------------------------------------------
+/* track start (the start sentinel) */
+static void ps2_kbd_magtrackstart(uint8_t ch)
 {
-  volatile unsigned int in;             /* Next In Index */
-  volatile unsigned int out;            /* Next Out Index */
-  char data[MOUSETBUF_SIZE];            /* Buffer */
-};
-
-static struct mousebuf_r mouserbuf = {0, 0,};
-static struct mousebuf_t mousetbuf = {0, 0,};
-uint8_t       read_packet_size = 0;
-volatile uint8_t mouse_rx_error = 0;
-
-__weak  void ps2_mouse_cbrx(uint32_t rx_datanum) { }
-__weak  void ps2_mouse_cbrxerror(uint32_t rx_errorcode) { }
+  if(ch == '%')
+    ps2_kbd_magtrack = 0;
+  else if((ch == ';') && (ps2_kbd_magstage.status[1] == PS2_TRACK_NONE))
+    ps2_kbd_magtrack = 1;
+  else
+    ps2_kbd_magtrack = 2;
+  ps2_kbd_magstage.len[ps2_kbd_magtrack] = 0;
+  ps2_kbd_magstage.track[ps2_kbd_magtrack][0] = 0;
+  ps2_kbd_magstage.status[ps2_kbd_magtrack] = PS2_TRACK_ERR; /* until the end sentinel */
+  ps2_kbd_maglrc = MAG_VALUE(ps2_kbd_magtrack, ch);
+}
 
 // ----------------------------------------------------------------------------
-/* ps2 mouse tx data read from tx fifo buffer */
-uint8_t cb_ps2_mousetx(uint8_t * txdata)
+/* end of the card: card -> ps2_kbd_magcard + callback
+   - held start sentinel or no end sentinel (human) -> the held key events -> RX fifo
+   - return: 0 = card, 1 = human */
+static uint8_t ps2_kbd_magend(void)
 {
-  if(FIFO_NOTEMPTY(mousetbuf))
-  { /* not empty */
-    if(txdata)
+  uint32_t i;
+  uint8_t  human = 0;
+  if((ps2_kbd_magstate == MAG_START) ||
+     ((ps2_kbd_magstate != MAG_IDLE) && !ps2_kbd_magframed && (ps2_kbd_magholdn <= MAG_HOLD)))
+  {
+    for(i = 0; i < ps2_kbd_magholdn; i++)
+      ps2_kbd_evstore(ps2_kbd_maghold[i]);
+    human = 1;
+  }
+  else if(ps2_kbd_magstate != MAG_IDLE)
+  {
+    if(!ps2_kbd_magready)
     {
-      FIFO_READ(mousetbuf, MOUSETBUF_SIZE, *txdata);
-      ps2_printf("mct:%X\r\n", (unsigned int)*txdata);
+      ps2_kbd_magcard = ps2_kbd_magstage;
+      ps2_kbd_magready = 1;
     }
-    return 1;
+    else
+    {
+      ps2_kbd_cbrxerror(PS2_ERROR_OVF);
+      ps2_printf("kcm:full!!\r\n");
+    }
+    ps2_kbd_cbcard(&ps2_kbd_magstage);
   }
-  else
-    return 0;
+  ps2_kbd_magholdn = 0;
+  ps2_kbd_magstate = MAG_IDLE;
+  return human;
 }
 
 // ----------------------------------------------------------------------------
-/* ps2 mouse rx data store to rx fifo buffer (callback) */
-void cb_ps2_mouserx(uint8_t rxdata, uint8_t error)
+/* key event -> card track
+   - the card starts with a start sentinel (or a modifier press + start sentinel) followed by the next character
+     within KBD_MAGSTRIPE_TIMEOUT (the start keys of a human are held until the timeout, then -> RX fifo)
+   - the card ends with enter or KBD_MAGSTRIPE_TIMEOUT, the key events of the card are dropped
+     (without end sentinel: human, the held key events -> RX fifo)
+   - the first character after the end sentinel is the LRC (a start sentinel only if it is not the good LRC)
+   - return: 0 = the key event is not used (-> RX fifo), 1 = held or card */
+static uint8_t ps2_kbd_magclass(ps2_KbdEvent * kbd_event)
 {
-  if(error)
+  uint32_t t = PS2_GETTIME();
+  uint8_t ch = (kbd_event->type == PS2_KEV_MAKE) ? kbd_event->ch : 0;
+  uint8_t tr;
+
+  if(ps2_kbd_magstate && (t - ps2_kbd_magtime > KBD_MAGSTRIPE_TIMEOUT))
+    ps2_kbd_magend();                   /* end of the card */
+  if(ps2_kbd_magstate == MAG_IDLE)
   {
-    mouse_rx_error = 1;
-    ps2_mouse_cbrxerror(PS2_ERROR_PARITY);
-    ps2_printf("mcr:parity!\r\n");
+    if((kbd_event->type == PS2_KEV_BREAK) && (kbd_event->usage == ps2_kbd_magdrop))
+    { /* the release of the card end enter */
+      ps2_kbd_magdrop = 0;
+      return 1;
+    }
+    if(!MAG_SENTINEL(ch) && ((kbd_event->type != PS2_KEV_MAKE) || (kbd_event->usage < PS2_HID_LCTRL)))
+      return 0;
+    for(tr = 0; tr < 3; tr++)
+    {
+      ps2_kbd_magstage.track[tr][0] = 0;
+      ps2_kbd_magstage.len[tr] = 0;
+      ps2_kbd_magstage.status[tr] = PS2_TRACK_NONE;
+    }
+    ps2_kbd_magtrack = MAG_NOTRACK;
+    ps2_kbd_magframed = 0;
+    ps2_kbd_magstate = MAG_START;
   }
+  ps2_kbd_magtime = t;
 
-  static uint8_t read_packet_cnt = 0;
-  if(FIFO_NOTFULL(mouserbuf, MOUSERBUF_SIZE))
+  if(ps2_kbd_magstate == MAG_START)
   {
-    FIFO_WRITE(mouserbuf, MOUSERBUF_SIZE, rxdata);
-    if(++read_packet_cnt >= read_packet_size)
-    {
-      ps2_mouse_cbrx(read_packet_cnt);
-      read_packet_cnt = 0;
-      ps2_printf("mcrp:%X\r\n", (unsigned int)rxdata);
+    if(ch && (ps2_kbd_magtrack != MAG_NOTRACK))
+    { /* fast character after the start sentinel: card */
+      ps2_kbd_magstate = MAG_DATA;
+    }
+    else if((ps2_kbd_magholdn < MAG_HOLD) &&
+            (MAG_SENTINEL(ch) || (kbd_event->type == PS2_KEV_BREAK) || (kbd_event->usage >= PS2_HID_LCTRL)))
+    { /* start sentinel, modifier, release: held */
+      if(ch)
+        ps2_kbd_magtrackstart(ch);
+      ps2_kbd_maghold[ps2_kbd_magholdn++] = KEV_PACK(*kbd_event);
+      return 1;
     }
     else
-      ps2_printf("mcr:%X\r\n", (unsigned int)rxdata);
+    { /* other key: human */
+      ps2_kbd_magend();
+      return 0;
+    }
   }
-  else
+
+  if(!ps2_kbd_magframed)
+  { /* the key events are held until the first end sentinel */
+    if(ps2_kbd_magholdn < MAG_HOLD)
+      ps2_kbd_maghold[ps2_kbd_magholdn++] = KEV_PACK(*kbd_event);
+    else
+      ps2_kbd_magholdn = MAG_HOLD + 1;
+  }
+
+  if(ch == 0)
+    return 1;                           /* card key release */
+  tr = ps2_kbd_magtrack;
+  if(ps2_kbd_magstate == MAG_DATA)
   {
-    ps2_mouse_cbrxerror(PS2_ERROR_OVF);
-    ps2_printf("mcr:full!!\r\n");
+    if(ch == PS2_ENTER)
+    { /* no end sentinel: the track status remains PS2_TRACK_ERR */
+      if(!ps2_kbd_magend())
+        ps2_kbd_magdrop = kbd_event->usage;
+    }
+    else
+    {
+      ps2_kbd_maglrc ^= MAG_VALUE(tr, ch);
+      if(ch == '?')
+      { /* end sentinel */
+        ps2_kbd_magframed = 1;
+        ps2_kbd_magholdn = 0;
+        ps2_kbd_magstate = MAG_LRC;
+        if(ps2_kbd_magstage.len[tr] <= KBD_MAGSTRIPE_TRACKLEN)
+          ps2_kbd_magstage.status[tr] = PS2_TRACK_OK;
+      }
+      else if(ps2_kbd_magstage.len[tr] < KBD_MAGSTRIPE_TRACKLEN)
+      {
+        ps2_kbd_magstage.track[tr][ps2_kbd_magstage.len[tr]++] = ch;
+        ps2_kbd_magstage.track[tr][ps2_kbd_magstage.len[tr]] = 0;
+      }
+      else
+        ps2_kbd_magstage.len[tr] = KBD_MAGSTRIPE_TRACKLEN + 1; /* too long: error */
+    }
   }
+  else
+  { /* MAG_LRC, MAG_END */
+    if(ch == PS2_ENTER)
+    {
+      ps2_kbd_magdrop = kbd_event->usage;
+      ps2_kbd_magend();
+    }
+    else if((ps2_kbd_magstate == MAG_LRC) && (MAG_VALUE(tr, ch) == ps2_kbd_maglrc))
+    { /* good LRC (also if it is a start sentinel character) */
+      if(ps2_kbd_magstage.status[tr] == PS2_TRACK_OK)
+        ps2_kbd_magstage.status[tr] = PS2_TRACK_LRCOK;
+      ps2_kbd_magstate = MAG_END;
+    }
+    else if(MAG_SENTINEL(ch))
+    { /* next track (the reader does not send LRC) */
+      ps2_kbd_magtrackstart(ch);
+      ps2_kbd_magstate = MAG_DATA;
+    }
+    else if(ps2_kbd_magstate == MAG_LRC)
+    { /* bad LRC */
+      if(ps2_kbd_magstage.status[tr] == PS2_TRACK_OK)
+        ps2_kbd_magstage.status[tr] = PS2_TRACK_LRCERR;
+      ps2_kbd_magstate = MAG_END;
+    }
+  }
+  if(ps2_kbd_magstage.len[tr] > KBD_MAGSTRIPE_TRACKLEN)
+    ps2_kbd_magstage.len[tr] = KBD_MAGSTRIPE_TRACKLEN;
+  return 1;
 }
 
 // ----------------------------------------------------------------------------
-
-t_Ps2   mouse = { cb_ps2_mouserx, cb_ps2_mousetx, 0, 0, 0, 0, PASSIVE };
-
-// ----------------------------------------------------------------------------
-/* low level data read from ps2 mouse
-   - param: pointer to 8 bits data
-   - return: 0 = no data available, 1 = data received
-   - note: if no data available -> the mouse_data does not change */
-uint8_t ps2_mouse_dataread(uint8_t * mouse_data)
+/* end of the card check (interrupt or IRQ disabled) */
+static inline void ps2_kbd_magpoll(void)
 {
-  if(FIFO_NOTEMPTY(mouserbuf))
-  { /* not empty */
-    FIFO_READ(mouserbuf, MOUSERBUF_SIZE, *mouse_data);
-    ps2_printf("mr:%X\r\n", (unsigned int)*mouse_data);
-    return 1;
-  }
-  else
-  { /* empty */
-    return 0;
-  }
+  if(ps2_kbd_magstate && (PS2_GETTIME() - ps2_kbd_magtime > KBD_MAGSTRIPE_TIMEOUT))
+    ps2_kbd_magend();
 }
+#endif
 
 // ----------------------------------------------------------------------------
-/* low level data write to ps2 mouse
-   - param: 8 bits data
-   - return: 0 = write buffer full, 1 = ok */
-uint8_t ps2_mouse_datawrite(uint8_t mouse_data)
+uint8_t ps2_kbd_datawrite(uint8_t kbd_data)
 {
-  if(FIFO_FULL(mousetbuf, MOUSETBUF_SIZE))
+  if(FIFO_FULL(kbdtbuf, KBDTBUF_SIZE))
     return 0;
 
-  FIFO_WRITE(mousetbuf, MOUSETBUF_SIZE, mouse_data);
-  ps2_printf("mt:%X\r\n", (unsigned int)mouse_data);
+  FIFO_WRITE(kbdtbuf, KBDTBUF_SIZE, kbd_data);  /* Add data to the transmit buffer. */
+  ps2_printf("kt:%X\r\n", (unsigned int)kbd_data);
 
-  if(mouse.status == PASSIVE)           /* can I send now? */
+  if(kbd.status == PASSIVE)             /* can I send now? */
   {
-    GPIOX_CLR(PS2_MOUSECLK);            /* CLK = 0 */
-    PS2_TIM->CNT = 0;                   /* Timer counter = 0 */
-    PS2_TIM->CR1 |= TIM_CR1_CEN;
-    PS2_MOUSETIM_ON;
-    mouse.status = SENDSTART;
-  }
-  return 1;
+    GPIOX_CLR(PS2_KBDCLK);              /* CLK = 0 */
+    TIM_RESTART;
+    PS2_KBDTIM_ON;                      /* Timer active */
+    kbd.status = SENDSTART;
+    ps2_printf("kts\r\n");
+  }
+  return 1;
 }
 
+volatile uint8_t ps2_kbd_scanset = 2;   /* active scan code set (2 or 3) */
+
 // ----------------------------------------------------------------------------
-/* low level ps2 mouse init */
-static inline void ps2_mouseinit(void)
-{
-  GPIOX_SET(PS2_MOUSECLK);              /* CLK = 1 */
-  GPIOX_ODOUT(PS2_MOUSECLK);
-  GPIOX_SET(PS2_MOUSEDATA);             /* DATA = 1 */
-  GPIOX_ODOUT(PS2_MOUSEDATA);
+/* keyboard command engine (one command byte / ACK, the answers are processed in the keyboard RX interrupt)
+   - the wanted keyboard settings (scan code set, typematic, LEDs) are compared with the applied settings,
+     one command sequence runs at once, the intermediate changes are collapsed into one update */
+#define  KCMD_IDLE            0         /* no command */
+#define  KCMD_ACK             1         /* waiting for ACK */
+#define  KCMD_SET             2         /* waiting for the scan code set (F0 00 answer) */
+#define  KCMD_TIMEOUT       100         /* keyboard answer timeout (ms) */
+#define  KCMD_RETRY           3         /* max. resend */
+#define  KCMD_UNKNOWN      0xFF         /* the applied setting is unknown */
+
+#if KBD_SCANSET3 >= 1
+/* set 3, query the scan code set */
+static const uint8_t ps2_kbd_set3cmd[] = {0xF0, 0x03, 0xF0, 0x00};
+/* all keys make only, the modifiers make/break (LCtrl, LShift, LAlt, RAlt, RCtrl, RShift, LGUI, RGUI), enable (end of the key list) */
+static const uint8_t ps2_kbd_set3cfg[] = {0xF9, 0xFC, 0x11, 0x12, 0x19, 0x39, 0x58, 0x59, 0x8B, 0x8C, 0xF4};
+/* set 2 (fallback) */
+static const uint8_t ps2_kbd_set2cmd[] = {0xF0, 0x02};
+#if KBD_SCANSET3 == 2
+volatile uint8_t ps2_kbd_setwant = 3;   /* wanted scan code set */
+#else
+volatile uint8_t ps2_kbd_setwant = 2;
+#endif
+#endif
 
-  EXTI_INIT(PS2_MOUSECLK);
+#if KBD_SWREPEAT == 1
+volatile uint8_t ps2_kbd_typwant = PS2_TYPEMATIC_DELAY_1000 | 0x1F; /* software repeat: the slowest keyboard typematic */
+#else
+volatile uint8_t ps2_kbd_typwant = KCMD_UNKNOWN; /* wanted typematic (KCMD_UNKNOWN: keyboard default) */
+#endif
+volatile uint8_t ps2_kbd_typapplied = KCMD_UNKNOWN; /* applied typematic */
+volatile uint8_t ps2_kbd_ledapplied = KCMD_UNKNOWN; /* applied LEDs (the wanted: ps2_kbdlockstatus) */
+volatile uint8_t ps2_kbd_lederror = 0;  /* the last LED command has not been acknowledged */
+
+#if KBD_HOTPLUG == 1
+static const uint8_t ps2_kbd_echocmd[] = {0xEE}; /* keyboard presence check (answer: EE) */
+volatile uint8_t ps2_kbd_connstatus = 1; /* 0 = the keyboard is disconnected, 1 = connected */
+volatile uint32_t ps2_kbd_rxtime = 0;   /* last received byte time (ms) */
+__weak  void ps2_kbd_cbconnect(uint8_t kbd_connected) { }
+#endif
+uint8_t  ps2_kbd_typcmd[2] = {0xF3, 0};
+uint8_t  ps2_kbd_ledcmd[2] = {0xED, 0};
 
-  mouse.clockport = GPIOX(PS2_MOUSECLK);
-  mouse.dataport  = GPIOX(PS2_MOUSEDATA);
-  mouse.clockpinmask = 1 << (GPIOX_PIN(PS2_MOUSECLK));
-  mouse.datapinmask = 1 << (GPIOX_PIN(PS2_MOUSEDATA));
+volatile uint8_t ps2_kbd_cmdstate = KCMD_IDLE;
+const uint8_t *  ps2_kbd_cmd;           /* command sequence */
+const uint8_t *  ps2_kbd_cmdp;          /* the last sent command byte */
+const uint8_t *  ps2_kbd_cmdend;        /* command sequence end */
+uint8_t  ps2_kbd_cmdretry;              /* resend counter */
+uint32_t ps2_kbd_cmdtime;               /* the last sent command byte time */
 
-  NVIC->ISER[(((uint32_t)(int32_t)PS2_MOUSE_EXT_IRQ) >> 5UL)] = (uint32_t)(1UL << (((uint32_t)(int32_t)PS2_MOUSE_EXT_IRQ) & 0x1FUL));
-  NVIC->IP[((uint32_t)(int32_t)PS2_MOUSE_EXT_IRQ)] = (uint8_t)((PS2_IRQPRIORITY << (8U - __NVIC_PRIO_BITS)) & (uint32_t)0xFFUL);
-}
+#define  ps2_kbd_cmdstart(cmd)  ps2_kbd_cmdrun(cmd, cmd + sizeof(cmd))
 
-#endif  // if ((defined PS2_MOUSECLK) && defined PS2_MOUSEDATA))
+// ----------------------------------------------------------------------------
+/* command sequence start (interrupt or IRQ disabled) */
+static void ps2_kbd_cmdrun(const uint8_t * cmd, const uint8_t * cmdend)
+{
+  ps2_kbd_cmd = cmd;
+  ps2_kbd_cmdp = cmd;
+  ps2_kbd_cmdend = cmdend;
+  ps2_kbd_cmdretry = 0;
+  ps2_kbd_cmdtime = PS2_GETTIME();
+  ps2_kbd_cmdstate = KCMD_ACK;
+  ps2_kbd_datawrite(*cmd);
+}
 
-// ============================================================================
-/* common GPIO EXT interrupt (clock falling edge) */
-static inline void ps2_ext_int(t_Ps2 * ps2s)
+// ----------------------------------------------------------------------------
+/* next command sequence, if a wanted setting differs from the applied (interrupt or IRQ disabled) */
+static void ps2_kbd_cmdnext(void)
 {
-  #if PS2_PIN_DEBUG == 1
-  GPIOX_SET(PS2_PIN_DEBUG_1);
+  if(ps2_kbd_cmdstate != KCMD_IDLE)
+    return;
+  #if KBD_HOTPLUG == 1
+  if(!ps2_kbd_connstatus)
+    return;                             /* the settings are restored at the reconnection */
   #endif
-
-  #if PS2_CLOCKFILTER == 1
-  if(GPIOX_IDR_PS2PIN(ps2s->clockport, ps2s->clockpinmask))
+  #if KBD_SCANSET3 >= 1
+  if(ps2_kbd_setwant != ps2_kbd_scanset)
   {
-    #if PS2_PIN_DEBUG == 1
-    GPIOX_CLR(PS2_PIN_DEBUG_1);
-    #endif
-    return;
+    if(ps2_kbd_setwant == 3)
+      ps2_kbd_cmdstart(ps2_kbd_set3cmd);
+    else
+      ps2_kbd_cmdstart(ps2_kbd_set2cmd);
   }
-  #endif
-
-  /* databit = ps2 data pin */
-  if(GPIOX_IDR_PS2PIN(ps2s->dataport, ps2s->datapinmask))
-    ps2s->databit = 1;
   else
-    ps2s->databit = 0;
-
-  TIM_RESTART;
-
-  ps2s->bitcount--;
-
-  if(ps2s->status == PASSIVE)
-  {                                     /* PASSIVE */
-    PS2_TIM_ON;
-    if(ps2s->databit == 0)
-    {                                   /* PASSIVE startbit */
-      ps2s->status = REC;
-      ps2s->bitcount = 11;
-    }
-    else
-      ps2s->error = 1;
-    ps2s->parity = 0;
+  #endif
+  if((ps2_kbd_typwant != KCMD_UNKNOWN) && (ps2_kbd_typwant != ps2_kbd_typapplied))
+  {
+    ps2_kbd_typcmd[1] = ps2_kbd_typwant;
+    ps2_kbd_cmdstart(ps2_kbd_typcmd);
   }
-
-  else if(ps2s->status == REC)
-  {                                     /* REC */
-    if(ps2s->bitcount == 2)
-    {                                   /* REC parity */
-      if(ps2s->databit == ps2s->parity)
-        ps2s->error = 1;
-    }
-    else if(ps2s->bitcount == 1)
-    {                                   /* REC stopbit */
-      if(ps2s->databit == 1)
-      {                                 /* if no error and stopbit == 1 -> scancode to rec buffer */
-        ps2s->cb_rx(ps2s->data, ps2s->error);
-      }
-      ps2s->error = 0;
-      ps2s->parity = 0;
-      ps2s->data = 0;
-      ps2s->status = POST;
-    }
-    else
-    {                                   /* REC databits */
-      ps2s->data >>= 1;
-      if(ps2s->databit)
-      {
-        ps2s->data |= 0x80;
-        ps2s->parity = 1 - ps2s->parity;
-      }
-    }
+  else if(ps2_kbdlockstatus != ps2_kbd_ledapplied)
+  {
+    ps2_kbd_ledcmd[1] = ps2_kbdlockstatus;
+    ps2_kbd_cmdstart(ps2_kbd_ledcmd);
   }
+}
 
-  else if(ps2s->status == SEND)
-  {                                     /* SEND */
-    if(ps2s->bitcount == 2)
-    {                                   /* SEND parity */
-      if(!ps2s->parity)
-        GPIOX_SET_PS2PIN(ps2s->dataport, ps2s->datapinmask); /* DATA = 1 */
-      else
-        GPIOX_CLR_PS2PIN(ps2s->dataport, ps2s->datapinmask); /* DATA = 0 */
-    }
-    else if(ps2s->bitcount == 1)
-    {                                   /* SEND stopbit */
-      GPIOX_SET_PS2PIN(ps2s->dataport, ps2s->datapinmask); /* DATA = 1 */
-    }
-    else if(ps2s->bitcount == 0)
-    {                                   /* SEND ACK */
-      ps2s->data = 0;
-      ps2s->bitcount = 11;
-      ps2s->parity = 0;
-      ps2s->error = 0;
-      ps2s->status = POST;
-    }
-    else
-    {                                   /* SEND databits */
-      if(ps2s->data & 0x01)
-      {
-        GPIOX_SET_PS2PIN(ps2s->dataport, ps2s->datapinmask); /* DATA = 1 */
-        ps2s->parity = 1 - ps2s->parity;
-      }
-      else
-        GPIOX_CLR_PS2PIN(ps2s->dataport, ps2s->datapinmask); /* DATA = 0 */
-      ps2s->data >>= 1;
-    }
+// ----------------------------------------------------------------------------
+/* command sequence end (all command bytes acknowledged) */
+static void ps2_kbd_cmddone(void)
+{
+  ps2_kbd_cmdstate = KCMD_IDLE;
+  if(ps2_kbd_cmd == ps2_kbd_typcmd)
+    ps2_kbd_typapplied = ps2_kbd_typcmd[1];
+  else if(ps2_kbd_cmd == ps2_kbd_ledcmd)
+  {
+    ps2_kbd_ledapplied = ps2_kbd_ledcmd[1];
+    ps2_kbd_lederror = 0;
   }
+  #if KBD_SCANSET3 >= 1
+  else if(ps2_kbd_cmd == ps2_kbd_set2cmd)
+    ps2_kbd_scanset = 2;
+  #endif
+  ps2_kbd_cmdnext();
+}
 
-  else if(ps2s->status == POST)
+// ----------------------------------------------------------------------------
+/* command error (no answer, resend over)
+   - set 3 -> set 2 fallback, the other commands: dropped (no resend loop), sent again at the next change */
+static void ps2_kbd_cmderror(void)
+{
+  ps2_kbd_cmdstate = KCMD_IDLE;
+  if(ps2_kbd_cmd == ps2_kbd_typcmd)
+    ps2_kbd_typapplied = ps2_kbd_typwant;
+  else if(ps2_kbd_cmd == ps2_kbd_ledcmd)
   {
-    ps2s->bitcount = 11;
-    ps2s->status = REC;
+    ps2_kbd_ledapplied = ps2_kbdlockstatus;
+    ps2_kbd_lederror = 1;
   }
-  #if PS2_PIN_DEBUG == 1
-  GPIOX_CLR(PS2_PIN_DEBUG_1);
+  #if KBD_SCANSET3 >= 1
+  if((ps2_kbd_cmd == ps2_kbd_set3cmd) || (ps2_kbd_cmd == ps2_kbd_set3cfg))
+  {
+    ps2_kbd_setwant = 2;
+    ps2_kbd_cmdstart(ps2_kbd_set2cmd);
+  }
+  else if(ps2_kbd_cmd == ps2_kbd_set2cmd)
+    ps2_kbd_scanset = 2;
   #endif
 }
 
 // ----------------------------------------------------------------------------
-static inline void ps2_timer_int(t_Ps2 * ps2s)
+/* command answer processing (keyboard RX interrupt)
+   - return: 0 = not a command answer (scan code), 1 = command answer */
+static uint8_t ps2_kbd_cmdrx(uint8_t rxdata)
 {
-  uint8_t data8;
-  #if PS2_PIN_DEBUG == 1
-  GPIOX_SET(PS2_PIN_DEBUG_2);
-  #endif
-  if(ps2s->status == SENDSTART)
+  #if KBD_SCANSET3 >= 1
+  if(ps2_kbd_cmdstate == KCMD_SET)
   {
-    if(ps2s->cb_tx(&data8))
-    {
-      TIM_RESTART;                      /* timer counter reset + timer start */
-      GPIOX_CLR_PS2PIN(ps2s->dataport, ps2s->datapinmask);   /* ps2 data pin = 0 */
-      GPIOX_SET_PS2PIN(ps2s->clockport, ps2s->clockpinmask); /* ps2 clock pin = 1 */
-      ps2s->bitcount = 11;
-      ps2s->data = data8;
-      ps2s->parity = 0;
-      ps2s->status = SEND;
+    if(rxdata == 0xFA)
+      return 1;
+    ps2_kbd_cmdstate = KCMD_IDLE;
+    if(rxdata == 0x03)
+    { /* the keyboard is in set 3 */
+      ps2_kbd_scanset = 3;
+      ps2_kbd_cmdstart(ps2_kbd_set3cfg);
     }
     else
-    {
-      GPIOX_SET_PS2PIN(ps2s->dataport, ps2s->datapinmask);   /* ps2 data pin = 1 */
-      GPIOX_SET_PS2PIN(ps2s->clockport, ps2s->clockpinmask); /* ps2 clock pin = 1 */
-      ps2s->status = PASSIVE;
+    { /* the keyboard does not know set 3 */
+      ps2_kbd_setwant = 2;
+      ps2_kbd_cmdstart(ps2_kbd_set2cmd);
     }
+    return 1;
   }
-  else
-  {
-    #if 0
-    if(ps2s->status == SEND)
-    {
-    }
-    else if(ps2s->status == POST)
-    {
-    }
-    else if(ps2s->status == REC)
-    {
-    }
-    #endif
+  #endif
 
-    GPIOX_SET_PS2PIN(ps2s->dataport, ps2s->datapinmask);  /* ps2 data pin = 1 */
-    if(ps2s->cb_tx(NULL) && (GPIOX_IDR_PS2PIN(ps2s->dataport, ps2s->datapinmask)))
-    {                                   /* tx buffer not empty and data pin is high */
-      GPIOX_CLR_PS2PIN(ps2s->clockport, ps2s->clockpinmask); /* ps2 clock pin = 0 */
-      PS2_TIM->CNT = 0;                 /* timer counter reset */
-      PS2_TIM->CR1 |= TIM_CR1_CEN;
-      PS2_TIM_ON;                       /* timer active */
-      ps2s->status = SENDSTART;
-    }
-    else
-    {
-      GPIOX_SET_PS2PIN(ps2s->clockport, ps2s->clockpinmask); /* ps2 clock pin = 1 */
-      ps2s->status = PASSIVE;
-      PS2_TIM_OFF;
-    }
+  #if KBD_HOTPLUG == 1
+  if((rxdata == 0xEE) && (ps2_kbd_cmd == ps2_kbd_echocmd))
+  { /* echo answer */
+    ps2_kbd_cmddone();
+    return 1;
   }
-  #if PS2_PIN_DEBUG == 1
-  GPIOX_CLR(PS2_PIN_DEBUG_2);
   #endif
-}
 
-// ----------------------------------------------------------------------------
-/* common kbd and mouse clock EXT input (falling edge) interrupt */
-#if (PS2_KBD_EXT_N >= 1) && (PS2_MOUSE_EXT_N >= 1) && (PS2_KBD_EXT_N == PS2_MOUSE_EXT_N)
-void PS2_KBD_EXT_IRQHandler(void)
-{
-  if(EXTI_GET(PS2_KBDCLK))
-  {
-    EXTI_CLR(PS2_KBDCLK);
-    ps2_ext_int(&kbd);
+  if(rxdata == 0xFA)
+  { /* ACK: next command byte */
+    ps2_kbd_cmdretry = 0;
+    ps2_kbd_cmdtime = PS2_GETTIME();
+    if(++ps2_kbd_cmdp < ps2_kbd_cmdend)
+      ps2_kbd_datawrite(*ps2_kbd_cmdp);
+    #if KBD_SCANSET3 >= 1
+    else if(ps2_kbd_cmd == ps2_kbd_set3cmd)
+      ps2_kbd_cmdstate = KCMD_SET;
+    #endif
+    else
+      ps2_kbd_cmddone();
+    return 1;
   }
-  if(EXTI_GET(PS2_MOUSECLK))
-  {
-    EXTI_CLR(PS2_MOUSECLK);
-    ps2_ext_int(&mouse);
+  if((rxdata == 0xFE) || (rxdata == 0xFC))
+  { /* resend, error */
+    if(++ps2_kbd_cmdretry > KCMD_RETRY)
+      ps2_kbd_cmderror();
+    else
+      ps2_kbd_datawrite(*ps2_kbd_cmdp);
+    return 1;
   }
+  return 0;
 }
-#endif
 
+#if KBD_HOTPLUG == 1
 // ----------------------------------------------------------------------------
-/* keyboard clock EXT input (falling edge) interrupt */
-#if (PS2_KBD_EXT_N >= 1) && (PS2_KBD_EXT_N != PS2_MOUSE_EXT_N)
-void PS2_KBD_EXT_IRQHandler(void)
+/* the keyboard is there (keyboard RX interrupt)
+   - kbd_bat = 1: the BAT (0xAA) arrived, plugged in (or reset), the keyboard settings are the defaults
+   - kbd_bat = 0: a byte from the disconnected keyboard (it was only silent), the settings are applied again */
+static void ps2_kbd_connect(uint8_t kbd_bat)
 {
-  if(EXTI_GET(PS2_KBDCLK))
+  if(kbd_bat)
   {
-    EXTI_CLR(PS2_KBDCLK);
-    ps2_ext_int(&kbd);
+    ps2_kbd_cmdstate = KCMD_IDLE;       /* the running command is lost */
+    ps2_kbd_scanset = 2;
   }
+  ps2_kbd_typapplied = KCMD_UNKNOWN;
+  ps2_kbd_ledapplied = KCMD_UNKNOWN;
+  if(!ps2_kbd_connstatus)
+  {
+    ps2_kbd_connstatus = 1;
+    ps2_printf("kbd connect\r\n");
+    ps2_kbd_cbconnect(1);
+  }
+  ps2_kbd_cmdnext();                    /* restore the LEDs, typematic, scan code set */
 }
-#endif
 
 // ----------------------------------------------------------------------------
-/* mouse clock EXT input (falling edge) interrupt */
-#if (PS2_MOUSE_EXT_N >= 1) && (PS2_KBD_EXT_N != PS2_MOUSE_EXT_N)
-void PS2_MOUSE_EXT_IRQHandler(void)
+/* the keyboard does not answer (after the resends): unplugged (IRQ disabled) */
+static void ps2_kbd_disconnect(void)
 {
-  if(EXTI_GET(PS2_MOUSECLK))
+  ps2_kbd_cmdstate = KCMD_IDLE;
+  if(ps2_kbd_connstatus)
   {
-    EXTI_CLR(PS2_MOUSECLK);
-    ps2_ext_int(&mouse);
+    ps2_kbd_connstatus = 0;
+    ps2_kbd_keyreset();                 /* the held keys are released */
+    ps2_printf("kbd disconnect\r\n");
+    ps2_kbd_cbconnect(0);
   }
 }
 #endif
 
 // ----------------------------------------------------------------------------
-/* timer interrupt */
-void PS2_TIM_HANDLER(void)
+/* command timeout check, next command, keyboard presence check */
+static void ps2_kbd_cmdpoll(void)
 {
-  if(TIM_IRQ_GET)
-  {
-    #if (PS2_KBD_EXT_N >= 1) && (PS2_MOUSE_EXT_N >= 1)
-    if(kbd.timermode)
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  if(ps2_kbd_cmdstate && (PS2_GETTIME() - ps2_kbd_cmdtime > KCMD_TIMEOUT))
+  { /* no answer (lost ACK, slow keyboard or unplugged) */
+    if(++ps2_kbd_cmdretry <= KCMD_RETRY)
     {
-      ps2_timer_int(&kbd);
+      ps2_kbd_cmdtime = PS2_GETTIME();
+      ps2_kbd_datawrite(*ps2_kbd_cmdp); /* resend */
     }
-    if(mouse.timermode)
+    else
     {
-      ps2_timer_int(&mouse);
+      ps2_kbd_cmderror();
+      #if KBD_HOTPLUG == 1
+      ps2_kbd_disconnect();             /* no answer after the resends */
+      #endif
     }
-    #elif PS2_KBD_EXT_N >= 1
-    ps2_timer_int(&kbd);
-    #elif PS2_MOUSE_EXT_N >= 1
-    ps2_timer_int(&mouse);
-    #endif
   }
-  TIM_IRQ_CLR;
+  ps2_kbd_cmdnext();
+  #if (KBD_HOTPLUG == 1) && (KBD_HOTPLUG_POLL > 0)
+  if(!ps2_kbd_cmdstate && (PS2_GETTIME() - ps2_kbd_rxtime > KBD_HOTPLUG_POLL))
+  { /* the keyboard has been silent for a long time (or disconnected): echo */
+    ps2_kbd_rxtime = PS2_GETTIME();
+    ps2_kbd_cmdstart(ps2_kbd_echocmd);
+  }
+  #endif
+  __set_PRIMASK(primask);
+}
+
+#if KBD_SCANSET3 >= 1
+#define  SCN_LOCK(set2, set3)  ((ps2_kbd_scanset == 3) ? set3 : set2)
+#define  SCN_MAKEONLY(usage)   ((ps2_kbd_scanset == 3) && ((usage) < PS2_HID_LCTRL)) /* set 3 make only key */
+#else
+#define  SCN_LOCK(set2, set3)  set2
+#define  SCN_MAKEONLY(usage)   0
+#endif
+
+// ----------------------------------------------------------------------------
+#if KBD_RXDECODE == 0
+uint8_t ps2_kbd_dataread(uint8_t * kbd_data)
+{
+  if(FIFO_NOTEMPTY(kbdrbuf))
+  { /* not empty */
+    FIFO_READ(kbdrbuf, KBDRBUF_SIZE, *kbd_data);
+    ps2_printf("kr:%X\r\n", (unsigned int)*kbd_data);
+    return 1;
+  }
+  else
+  { /* empty */
+    return 0;
+  }
+}
+#endif
+
+// ----------------------------------------------------------------------------
+/* PS2 keyboard tx data get from tx fifo buffer (if txdata == NULL -> only tx buffer data info) */
+uint8_t cb_ps2_kbdtx(uint8_t * txdata)
+{
+  if(FIFO_NOTEMPTY(kbdtbuf))
+  {
+    if(txdata)
+    {
+      FIFO_READ(kbdtbuf, KBDTBUF_SIZE, *txdata);
+      ps2_printf("kct:%X\r\n", (unsigned int)*txdata);
+    }
+    return 1;
+  }
+  else
+    return 0;
+}
+
+#if KBD_RXDECODE == 1
+// ----------------------------------------------------------------------------
+/* the decoded key event to the RX interrupt key event consumer (barcode scanner, magnetic stripe card)
+   - return: 0 = not consumed (-> RX fifo), 1 = consumed or held by the consumer */
+static inline uint8_t ps2_kbd_evconsume(ps2_KbdEvent * kbd_event)
+{
+  #if KBD_SCANNER == 1
+  ps2_kbd_evchar(kbd_event);
+  return ps2_kbd_scankey(kbd_event);    /* character -> barcode string */
+  #elif KBD_SCANNER == 2
+  ps2_kbd_evchar(kbd_event);
+  return ps2_kbd_scanclass(kbd_event);  /* held or scanner */
+  #elif KBD_MAGSTRIPE == 1
+  ps2_kbd_evchar(kbd_event);
+  return ps2_kbd_magclass(kbd_event);   /* held or card */
+  #else
+  return 0;
+  #endif
+}
+#endif
+
+// ----------------------------------------------------------------------------
+/* PS2 keyboard rx data store to rx fifo buffer
+   (KBD_RXDECODE == 1: the scan code is decoded here and the finished key event is stored) */
+void cb_ps2_kbdrx(uint8_t rxdata, uint8_t error)
+{
+  static uint8_t predata = 0, pausecnt = 0, lockdown = 0;
+  uint8_t lock = 0;
+  if(error)
+  {
+    kbd_rx_error = 1;
+  }
+
+  #if KBD_HOTPLUG == 1
+  ps2_kbd_rxtime = PS2_GETTIME();
+  if((rxdata == 0xAA) && (predata != 0xF0) && (predata != 0xE0) && !pausecnt)
+  { /* BAT completion */
+    lockdown = 0;
+    ps2_kbd_connect(1);
+  }
+  else if(!ps2_kbd_connstatus && !error)
+    ps2_kbd_connect(0);                 /* any byte: the keyboard is there, the settings again */
+  #endif
+  if(ps2_kbd_cmdstate && ps2_kbd_cmdrx(rxdata))
+  { /* command answer */
+    ps2_kbd_cbrx(rxdata);
+    return;
+  }
+
+  #if KBD_RXDECODE == 0
+  if(FIFO_NOTFULL(kbdrbuf, KBDRBUF_SIZE))
+  {
+    FIFO_WRITE(kbdrbuf, KBDRBUF_SIZE, rxdata);
+    ps2_printf("kcr:%X\r\n", (unsigned int)rxdata);
+  }
+  else
+  {
+    ps2_kbd_cbrxerror(PS2_ERROR_OVF);
+    ps2_printf("kcr:full!!\r\n");
+  }
+  #endif
+
+  if(pausecnt)
+    pausecnt--;                         /* inside the pause sequence (E1 14 77 E1 F0 14 F0 77) */
+  else if(rxdata == 0xE1)
+    pausecnt = 7;
+  else if((predata != 0xE0) && (rxdata != 0xFA))
+  { /* LED change */
+    if(rxdata == SCN_LOCK(SCN_CAPSLOCK, SCN3_CAPSLOCK))
+      lock = ST_KBDCAPSLOCK;            /* capslock */
+    else if(rxdata == SCN_LOCK(SCN_NUMLOCK, SCN3_NUMLOCK))
+      lock = ST_KBDNUMLOCK;             /* numlock */
+    else if(rxdata == SCN_LOCK(SCN_SCRLOCK, SCN3_SCRLOCK))
+      lock = ST_KBDSCRLOCK;             /* scrlock */
+    if(predata == 0xF0)
+      lockdown &= ~lock;                /* lock button release */
+    else if(lock & ~lockdown)
+    { /* lock button press (the typematic repeat of the held lock button does not toggle) */
+      if(ps2_kbd_scanset == 2)
+        lockdown |= lock;               /* set 3: the lock buttons are make only */
+      ps2_kbdlockstatus ^= lock;
+      ps2_printf("key lock:%X\r\n", (unsigned int)ps2_kbdlockstatus);
+      ps2_kbd_cmdnext();                /* LED update (if the keyboard is busy: after the running command) */
+      ps2_kbd_cbstatus(ps2_kbd_ctrlstatus(), ps2_kbdlockstatus);
+    }
+  }
+  predata = rxdata;
+
+  #if KBD_RXDECODE == 1
+  ps2_KbdEvent ev;
+  if(ps2_kbd_decode(rxdata, &ev) && !ps2_kbd_evconsume(&ev) && (KBD_RXBREAKS || (ev.type != PS2_KEV_BREAK)))
+    ps2_kbd_evstore(KEV_PACK(ev));
+  #endif
+
+  ps2_kbd_cbrx(rxdata);
+}
+
+
+// ----------------------------------------------------------------------------
+/* low level ps2 keyboard init */
+static inline void ps2_kbdinit(void)
+{
+  GPIOX_SET(PS2_KBDCLK);                /* CLK = 1 */
+  GPIOX_ODOUT(PS2_KBDCLK);              /* CLK = OD out */
+
+  GPIOX_SET(PS2_KBDDATA);               /* DATA = 1 */
+  GPIOX_ODOUT(PS2_KBDDATA);             /* DATA = OD out */
+
+  EXTI_INIT(PS2_KBDCLK);
+
+  kbd.clockport = GPIOX(PS2_KBDCLK);
+  kbd.dataport  = GPIOX(PS2_KBDDATA);
+  kbd.clockpinmask = 1 << (GPIOX_PIN(PS2_KBDCLK));
+  kbd.datapinmask = 1 << (GPIOX_PIN(PS2_KBDDATA));
+
+  NVIC->ISER[(((uint32_t)(int32_t)PS2_KBD_EXT_IRQ) >> 5UL)] = (uint32_t)(1UL << (((uint32_t)(int32_t)PS2_KBD_EXT_IRQ) & 0x1FUL));
+  NVIC->IP[((uint32_t)(int32_t)PS2_KBD_EXT_IRQ)] = (uint8_t)((PS2_IRQPRIORITY << (8U - __NVIC_PRIO_BITS)) & (uint32_t)0xFFUL);
+}
+
+#endif  // #if  PS2_KBD_EXT_N >= 1
+
+// ----------------------------------------------------------------------------
+/* mouse low level */
+#if  PS2_MOUSE_EXT_N >= 1
+
+struct mousebuf_r
+{
+  volatile unsigned int in;             /* Next In Index */
+  volatile unsigned int out;            /* Next Out Index */
+  char data[MOUSERBUF_SIZE];            /* Buffer */
+};
+
+struct mousebuf_t
+{
+  volatile unsigned int in;             /* Next In Index */
+  volatile unsigned int out;            /* Next Out Index */
+  char data[MOUSETBUF_SIZE];            /* Buffer */
+};
+
+#if (MOUSE_EVENTS == 1) || (MOUSE_SUM_AGE > 0)
+#define  MOUSE_RXTIME         1         /* receive time of the mouse packets */
+#else
+#define  MOUSE_RXTIME         0
+#endif
+
+static struct mousebuf_r mouserbuf = {0, 0,};
+#if MOUSE_RXTIME == 1
+#define  MOUSERXTIME_SIZE     (MOUSERBUF_SIZE / 2) /* min. 3 bytes / packet: enough for the packets in mouserbuf */
+static uint32_t mouserxtime[MOUSERXTIME_SIZE]; /* receive time of the packets (header byte, us) */
+static volatile uint32_t mouserxtin = 0; /* next mouserxtime index */
+#endif
+static struct mousebuf_t mousetbuf = {0, 0,};
+uint8_t       read_packet_size = 0;
+volatile uint8_t mouse_rx_error = 0;
+
+#define  MCMD_IDLE            0         /* no command (the mouse packets -> RX fifo) */
+#define  MCMD_ACK             1         /* waiting for ACK */
+#define  MCMD_ANSWER          2         /* waiting for the answer bytes */
+
+volatile uint8_t ps2_mouse_cmdstate = MCMD_IDLE;
+static uint8_t ps2_mouse_cmdrx(uint8_t rxdata);
+
+#define  MOUSE_MODE_REMOTE        0
+#define  MOUSE_MODE_STREAM        1
+#define  MOUSE_MODE_UNKNOWN       0xFF
+
+uint8_t  ps2_mouse_mode = MOUSE_MODE_UNKNOWN; /* applied mouse mode */
+volatile uint8_t ps2_mouse_rxphase = 0; /* received bytes of the actual packet (stream mode: command answer only at 0) */
+volatile uint8_t ps2_mouse_rxbad = 0;   /* 1 = parity error in the actual packet, the rest of the packet is dropped */
+
+__weak  void ps2_mouse_cbrx(uint32_t rx_datanum) { }
+__weak  void ps2_mouse_cbrxerror(uint32_t rx_errorcode) { }
+
+// ----------------------------------------------------------------------------
+/* ps2 mouse tx data read from tx fifo buffer */
+uint8_t cb_ps2_mousetx(uint8_t * txdata)
+{
+  if(FIFO_NOTEMPTY(mousetbuf))
+  { /* not empty */
+    if(txdata)
+    {
+      FIFO_READ(mousetbuf, MOUSETBUF_SIZE, *txdata);
+      ps2_printf("mct:%X\r\n", (unsigned int)*txdata);
+    }
+    return 1;
+  }
+  else
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+/* ps2 mouse rx data store to rx fifo buffer (callback) */
+void cb_ps2_mouserx(uint8_t rxdata, uint8_t error)
+{
+  if(error)
+  {
+    ps2_mouse_cbrxerror(PS2_ERROR_PARITY);
+    ps2_printf("mcr:parity!\r\n");
+    if(ps2_mouse_cmdstate || (ps2_mouse_mode == MOUSE_MODE_UNKNOWN))
+    {
+      mouse_rx_error = 1;               /* command or init: the mouse is initialized again */
+      return;
+    }
+    if(!ps2_mouse_rxbad)
+    { /* packet byte: the stored bytes of the packet are dropped (if they are not read yet) */
+      mouserbuf.in -= (ps2_mouse_rxphase < FIFO_LEN(mouserbuf)) ? ps2_mouse_rxphase : FIFO_LEN(mouserbuf);
+      ps2_mouse_rxbad = 1;
+    }
+  }
+
+  if(ps2_mouse_cmdstate && (!ps2_mouse_rxphase || (ps2_mouse_mode != MOUSE_MODE_STREAM)) && ps2_mouse_cmdrx(rxdata))
+    return;                             /* command answer (stream mode: not the inside of a packet, e.g. FA move) */
+
+  #if MOUSE_RXTIME == 1
+  uint8_t hdr = !ps2_mouse_rxphase;     /* packet header byte */
+  #endif
+  if(++ps2_mouse_rxphase >= read_packet_size)
+    ps2_mouse_rxphase = 0;
+  if(ps2_mouse_rxbad)
+  { /* the bad packet is dropped until its end */
+    if(!ps2_mouse_rxphase)
+      ps2_mouse_rxbad = 0;
+    return;
+  }
+  if(FIFO_NOTFULL(mouserbuf, MOUSERBUF_SIZE))
+  {
+    #if MOUSE_RXTIME == 1
+    if(hdr)
+      mouserxtime[mouserxtin++ & (MOUSERXTIME_SIZE - 1)] = PS2_GETTIME_US();
+    #endif
+    FIFO_WRITE(mouserbuf, MOUSERBUF_SIZE, rxdata);
+    if(!ps2_mouse_rxphase)
+    {
+      ps2_mouse_cbrx(read_packet_size);
+      ps2_printf("mcrp:%X\r\n", (unsigned int)rxdata);
+    }
+    else
+      ps2_printf("mcr:%X\r\n", (unsigned int)rxdata);
+  }
+  else
+  {
+    ps2_mouse_cbrxerror(PS2_ERROR_OVF);
+    ps2_printf("mcr:full!!\r\n");
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+t_Ps2   mouse = { cb_ps2_mouserx, cb_ps2_mousetx, 0, 0, 0, 0, PASSIVE };
+
+// ----------------------------------------------------------------------------
+/* low level data read from ps2 mouse
+   - param: pointer to 8 bits data
+   - return: 0 = no data available, 1 = data received
+   - note: if no data available -> the mouse_data does not change */
+uint8_t ps2_mouse_dataread(uint8_t * mouse_data)
+{
+  if(FIFO_NOTEMPTY(mouserbuf))
+  { /* not empty */
+    FIFO_READ(mouserbuf, MOUSERBUF_SIZE, *mouse_data);
+    ps2_printf("mr:%X\r\n", (unsigned int)*mouse_data);
+    return 1;
+  }
+  else
+  { /* empty */
+    return 0;
+  }
+}
+
+// ----------------------------------------------------------------------------
+/* low level data write to ps2 mouse
+   - param: 8 bits data
+   - return: 0 = write buffer full, 1 = ok */
+uint8_t ps2_mouse_datawrite(uint8_t mouse_data)
+{
+  if(FIFO_FULL(mousetbuf, MOUSETBUF_SIZE))
+    return 0;
+
+  FIFO_WRITE(mousetbuf, MOUSETBUF_SIZE, mouse_data);
+  ps2_printf("mt:%X\r\n", (unsigned int)mouse_data);
+
+  if(mouse.status == PASSIVE)           /* can I send now? */
+  {
+    GPIOX_CLR(PS2_MOUSECLK);            /* CLK = 0 */
+    PS2_TIM->CNT = 0;                   /* Timer counter = 0 */
+    PS2_TIM->CR1 |= TIM_CR1_CEN;
+    PS2_MOUSETIM_ON;
+    mouse.status = SENDSTART;
+  }
+  return 1;
+}
+
+// ----------------------------------------------------------------------------
+/* mouse command engine (one command byte / ACK, the answers are processed in the mouse RX interrupt)
+   - command sequence: command byte + answer byte number (after the ACK) pairs
+   - the init sequence is started from ps2_mouse_getmove, it does not wait for the mouse answers */
+#define  MCMD_RETRY           3         /* max. resend */
+
+#define  MOUSE_UNINITIALIZATION   0     /* no connection the mouse or before reset */
+#define  MOUSE_INIT               1     /* the init sequence is running */
+#define  MOUSE_READY              2     /* the mouse is initialized */
+
+/* reset, sample rate 200, 100, 80 (wheel mouse knock), mouse ID */
+static const uint8_t ps2_mouse_initcmd[] = {0xFF, 2, 0xF3, 0, 0xC8, 0, 0xF3, 0, 0x64, 0, 0xF3, 0, 0x50, 0, 0xF2, 1};
+/* sample rate 200, 200, 80 (5 button mouse knock, after ID 3), mouse ID */
+static const uint8_t ps2_mouse_explorercmd[] = {0xF3, 0, 0xC8, 0, 0xF3, 0, 0xC8, 0, 0xF3, 0, 0x50, 0, 0xF2, 1};
+/* stream mode, enable data reporting (method 3) */
+static const uint8_t ps2_mouse_streamcmd[] = {0xEA, 0, 0xF4, 0};
+/* disable data reporting, remote mode (method 1, 2) */
+static const uint8_t ps2_mouse_remotecmd[] = {0xF5, 0, 0xF0, 0};
+/* read data (the packet after the ACK -> RX fifo) */
+static const uint8_t ps2_mouse_readcmd[] = {0xEB, 0};
+
+uint8_t  ps2_mouse_method = MOUSE_METHOD; /* get move method (1, 2, 3) */
+
+volatile uint8_t ps2_mouse_status = MOUSE_UNINITIALIZATION;
+const uint8_t *  ps2_mouse_cmd;         /* command sequence */
+const uint8_t *  ps2_mouse_cmdp;        /* the last sent command byte */
+const uint8_t *  ps2_mouse_cmdend;      /* command sequence end */
+uint8_t  ps2_mouse_cmdretry;            /* resend counter */
+uint32_t ps2_mouse_cmdtime;             /* the last sent command byte time */
+uint8_t  ps2_mouse_answer[3];           /* answer bytes */
+uint8_t  ps2_mouse_answern;
+uint8_t  ps2_mouse_id = 0;              /* mouse ID (0 = standard, 3 = wheel mouse, 4 = 5 button mouse) */
+#if MOUSE_ACCEL == 1
+static int32_t ps2_mouse_remx = 0, ps2_mouse_remy = 0; /* acceleration move fractions (1/256, ps2_mouse_accel) */
+#endif
+
+#define  ps2_mouse_cmdstart(cmd)  ps2_mouse_cmdrun(cmd, cmd + sizeof(cmd))
+
+// ----------------------------------------------------------------------------
+/* command sequence start (interrupt or IRQ disabled) */
+static void ps2_mouse_cmdrun(const uint8_t * cmd, const uint8_t * cmdend)
+{
+  ps2_mouse_cmd = cmd;
+  ps2_mouse_cmdp = cmd;
+  ps2_mouse_cmdend = cmdend;
+  ps2_mouse_cmdretry = 0;
+  ps2_mouse_cmdtime = PS2_GETTIME();
+  ps2_mouse_cmdstate = MCMD_ACK;
+  ps2_mouse_datawrite(*cmd);
+}
+
+// ----------------------------------------------------------------------------
+/* stream or remote mode set (for the get move method), the old packets are dropped
+   - the mouse status is MOUSE_INIT until the mode commands are done
+   - stream -> remote: the rest of the actual packet is not a command answer (ps2_mouse_rxphase) */
+static void ps2_mouse_setmode(void)
+{
+  uint8_t tmp8;
+  while(ps2_mouse_dataread(&tmp8));     /* receive buffer empty */
+  #if MOUSE_ACCEL == 1
+  ps2_mouse_remx = 0;                   /* the move fractions of the old packets */
+  ps2_mouse_remy = 0;
+  #endif
+  ps2_mouse_status = MOUSE_INIT;
+  if(ps2_mouse_method == 3)
+    ps2_mouse_cmdstart(ps2_mouse_streamcmd);
+  else
+    ps2_mouse_cmdstart(ps2_mouse_remotecmd);
+}
+
+// ----------------------------------------------------------------------------
+/* command error (no answer, resend over, bad answer): the mouse is initialized again */
+static void ps2_mouse_cmderror(void)
+{
+  ps2_mouse_cmdstate = MCMD_IDLE;
+  ps2_mouse_status = MOUSE_UNINITIALIZATION;
+  ps2_printf("mouse cmd error:%X\r\n", (unsigned int)*ps2_mouse_cmdp);
+}
+
+// ----------------------------------------------------------------------------
+/* the command byte and its answers are arrived: next command byte */
+static void ps2_mouse_cmdstep(void)
+{
+  if(*ps2_mouse_cmdp == 0xFF)
+  { /* reset: AA 00 */
+    if((ps2_mouse_answer[0] != 0xAA) || (ps2_mouse_answer[1] != 0x00))
+    {
+      ps2_mouse_cmderror();
+      return;
+    }
+  }
+  else if(*ps2_mouse_cmdp == 0xF2)
+  { /* mouse ID */
+    ps2_mouse_id = ps2_mouse_answer[0];
+    read_packet_size = ((ps2_mouse_id == 0x03) || (ps2_mouse_id == 0x04)) ? 4 : 3;
+  }
+
+  ps2_mouse_cmdp += 2;
+  ps2_mouse_cmdretry = 0;
+  ps2_mouse_cmdtime = PS2_GETTIME();
+  if(ps2_mouse_cmdp < ps2_mouse_cmdend)
+  {
+    ps2_mouse_cmdstate = MCMD_ACK;
+    ps2_mouse_datawrite(*ps2_mouse_cmdp);
+  }
+  else
+  {
+    ps2_mouse_cmdstate = MCMD_IDLE;
+    if((ps2_mouse_cmd == ps2_mouse_initcmd) && (ps2_mouse_id == 0x03))
+      ps2_mouse_cmdstart(ps2_mouse_explorercmd); /* wheel mouse: 5 button mouse test */
+    else if((ps2_mouse_cmd == ps2_mouse_initcmd) || (ps2_mouse_cmd == ps2_mouse_explorercmd))
+      ps2_mouse_setmode();              /* init end: the mode of the get move method */
+    else if((ps2_mouse_cmd == ps2_mouse_streamcmd) || (ps2_mouse_cmd == ps2_mouse_remotecmd))
+    {
+      uint8_t tmp8;
+      while(ps2_mouse_dataread(&tmp8)); /* the stream packets before the mode change */
+      ps2_mouse_rxphase = 0;
+      ps2_mouse_rxbad = 0;
+      ps2_mouse_mode = (ps2_mouse_cmd == ps2_mouse_streamcmd) ? MOUSE_MODE_STREAM : MOUSE_MODE_REMOTE;
+      ps2_mouse_status = MOUSE_READY;
+      ps2_printf("mouse ready, id:%X mode:%X\r\n", (unsigned int)ps2_mouse_id, (unsigned int)ps2_mouse_mode);
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+/* command answer processing (mouse RX interrupt)
+   - return: 0 = not a command answer (mouse packet), 1 = command answer */
+static uint8_t ps2_mouse_cmdrx(uint8_t rxdata)
+{
+  if(ps2_mouse_cmdstate == MCMD_ANSWER)
+  {
+    ps2_mouse_answer[ps2_mouse_answern++] = rxdata;
+    if(ps2_mouse_answern >= ps2_mouse_cmdp[1])
+      ps2_mouse_cmdstep();
+    return 1;
+  }
+  if(rxdata == 0xFA)
+  { /* ACK */
+    ps2_mouse_answern = 0;
+    if(ps2_mouse_cmdp[1])
+      ps2_mouse_cmdstate = MCMD_ANSWER;
+    else
+      ps2_mouse_cmdstep();
+    return 1;
+  }
+  if(rxdata == 0xFE)
+  { /* resend */
+    if(++ps2_mouse_cmdretry > MCMD_RETRY)
+      ps2_mouse_cmderror();
+    else
+      ps2_mouse_datawrite(*ps2_mouse_cmdp);
+    return 1;
+  }
+  if(rxdata == 0xFC)
+  { /* error */
+    ps2_mouse_cmderror();
+    return 1;
+  }
+  return 0;
+}
+
+// ----------------------------------------------------------------------------
+/* command timeout check, mouse init start (IRQ disabled) */
+static void ps2_mouse_cmdpoll(void)
+{
+  uint8_t tmp8;
+  if(mouse_rx_error)
+  { /* parity error in a command answer or at the init (the packet bytes: the packet is dropped) */
+    mouse_rx_error = 0;
+    ps2_mouse_cmdstate = MCMD_IDLE;
+    ps2_mouse_status = MOUSE_UNINITIALIZATION;
+  }
+  if(ps2_mouse_cmdstate &&
+     (PS2_GETTIME() - ps2_mouse_cmdtime > ((*ps2_mouse_cmdp == 0xFF) ? PS2_MOUSE_RESETTIME : PS2_MOUSE_RATETIME)))
+    ps2_mouse_cmderror();
+  if(ps2_mouse_status == MOUSE_UNINITIALIZATION)
+  {
+    while(ps2_mouse_dataread(&tmp8));   /* receive buffer empty */
+    read_packet_size = 1;
+    ps2_mouse_rxphase = 0;
+    ps2_mouse_rxbad = 0;
+    ps2_mouse_mode = MOUSE_MODE_UNKNOWN;
+    ps2_mouse_status = MOUSE_INIT;
+    ps2_mouse_cmdstart(ps2_mouse_initcmd);
+    ps2_printf("mouse reset\r\n");
+  }
+}
+
+// ----------------------------------------------------------------------------
+/* low level ps2 mouse init */
+static inline void ps2_mouseinit(void)
+{
+  GPIOX_SET(PS2_MOUSECLK);              /* CLK = 1 */
+  GPIOX_ODOUT(PS2_MOUSECLK);
+  GPIOX_SET(PS2_MOUSEDATA);             /* DATA = 1 */
+  GPIOX_ODOUT(PS2_MOUSEDATA);
+
+  EXTI_INIT(PS2_MOUSECLK);
+
+  mouse.clockport = GPIOX(PS2_MOUSECLK);
+  mouse.dataport  = GPIOX(PS2_MOUSEDATA);
+  mouse.clockpinmask = 1 << (GPIOX_PIN(PS2_MOUSECLK));
+  mouse.datapinmask = 1 << (GPIOX_PIN(PS2_MOUSEDATA));
+
+  NVIC->ISER[(((uint32_t)(int32_t)PS2_MOUSE_EXT_IRQ) >> 5UL)] = (uint32_t)(1UL << (((uint32_t)(int32_t)PS2_MOUSE_EXT_IRQ) & 0x1FUL));
+  NVIC->IP[((uint32_t)(int32_t)PS2_MOUSE_EXT_IRQ)] = (uint8_t)((PS2_IRQPRIORITY << (8U - __NVIC_PRIO_BITS)) & (uint32_t)0xFFUL);
+}
+
+#endif  // if ((defined PS2_MOUSECLK) && defined PS2_MOUSEDATA))
+
+// ============================================================================
+/* common GPIO EXT interrupt (clock falling edge) */
+static inline void ps2_ext_int(t_Ps2 * ps2s)
+{
+  #if PS2_PIN_DEBUG == 1
+  GPIOX_SET(PS2_PIN_DEBUG_1);
+  #endif
+
+  #if PS2_CLOCKFILTER == 1
+  if(GPIOX_IDR_PS2PIN(ps2s->clockport, ps2s->clockpinmask))
+  {
+    #if PS2_PIN_DEBUG == 1
+    GPIOX_CLR(PS2_PIN_DEBUG_1);
+    #endif
+    return;
+  }
+  #endif
+
+  /* databit = ps2 data pin */
+  if(GPIOX_IDR_PS2PIN(ps2s->dataport, ps2s->datapinmask))
+    ps2s->databit = 1;
+  else
+    ps2s->databit = 0;
+
+  TIM_RESTART;
+
+  ps2s->bitcount--;
+
+  if(ps2s->status == PASSIVE)
+  {                                     /* PASSIVE */
+    PS2_TIM_ON;
+    if(ps2s->databit == 0)
+    {                                   /* PASSIVE startbit */
+      ps2s->status = REC;
+      ps2s->bitcount = 11;
+    }
+    else
+      ps2s->error = 1;
+    ps2s->parity = 0;
+  }
+
+  else if(ps2s->status == REC)
+  {                                     /* REC */
+    if(ps2s->bitcount == 2)
+    {                                   /* REC parity */
+      if(ps2s->databit == ps2s->parity)
+        ps2s->error = 1;
+    }
+    else if(ps2s->bitcount == 1)
+    {                                   /* REC stopbit */
+      if(ps2s->databit == 1)
+      {                                 /* if no error and stopbit == 1 -> scancode to rec buffer */
+        ps2s->cb_rx(ps2s->data, ps2s->error);
+      }
+      ps2s->error = 0;
+      ps2s->parity = 0;
+      ps2s->data = 0;
+      ps2s->status = POST;
+    }
+    else
+    {                                   /* REC databits */
+      ps2s->data >>= 1;
+      if(ps2s->databit)
+      {
+        ps2s->data |= 0x80;
+        ps2s->parity = 1 - ps2s->parity;
+      }
+    }
+  }
+
+  else if(ps2s->status == SEND)
+  {                                     /* SEND */
+    if(ps2s->bitcount == 2)
+    {                                   /* SEND parity */
+      if(!ps2s->parity)
+        GPIOX_SET_PS2PIN(ps2s->dataport, ps2s->datapinmask); /* DATA = 1 */
+      else
+        GPIOX_CLR_PS2PIN(ps2s->dataport, ps2s->datapinmask); /* DATA = 0 */
+    }
+    else if(ps2s->bitcount == 1)
+    {                                   /* SEND stopbit */
+      GPIOX_SET_PS2PIN(ps2s->dataport, ps2s->datapinmask); /* DATA = 1 */
+    }
+    else if(ps2s->bitcount == 0)
+    {                                   /* SEND ACK */
+      ps2s->data = 0;
+      ps2s->bitcount = 11;
+      ps2s->parity = 0;
+      ps2s->error = 0;
+      ps2s->status = POST;
+    }
+    else
+    {                                   /* SEND databits */
+      if(ps2s->data & 0x01)
+      {
+        GPIOX_SET_PS2PIN(ps2s->dataport, ps2s->datapinmask); /* DATA = 1 */
+        ps2s->parity = 1 - ps2s->parity;
+      }
+      else
+        GPIOX_CLR_PS2PIN(ps2s->dataport, ps2s->datapinmask); /* DATA = 0 */
+      ps2s->data >>= 1;
+    }
+  }
+
+  else if(ps2s->status == POST)
+  {
+    ps2s->bitcount = 11;
+    ps2s->status = REC;
+  }
+  #if PS2_PIN_DEBUG == 1
+  GPIOX_CLR(PS2_PIN_DEBUG_1);
+  #endif
+}
+
+// ----------------------------------------------------------------------------
+static inline void ps2_timer_int(t_Ps2 * ps2s)
+{
+  uint8_t data8;
+  #if PS2_PIN_DEBUG == 1
+  GPIOX_SET(PS2_PIN_DEBUG_2);
+  #endif
+  if(ps2s->status == SENDSTART)
+  {
+    if(ps2s->cb_tx(&data8))
+    {
+      TIM_RESTART;                      /* timer counter reset + timer start */
+      GPIOX_CLR_PS2PIN(ps2s->dataport, ps2s->datapinmask);   /* ps2 data pin = 0 */
+      GPIOX_SET_PS2PIN(ps2s->clockport, ps2s->clockpinmask); /* ps2 clock pin = 1 */
+      ps2s->bitcount = 11;
+      ps2s->data = data8;
+      ps2s->parity = 0;
+      ps2s->status = SEND;
+    }
+    else
+    {
+      GPIOX_SET_PS2PIN(ps2s->dataport, ps2s->datapinmask);   /* ps2 data pin = 1 */
+      GPIOX_SET_PS2PIN(ps2s->clockport, ps2s->clockpinmask); /* ps2 clock pin = 1 */
+      ps2s->status = PASSIVE;
+    }
+  }
+  else
+  {
+    #if 0
+    if(ps2s->status == SEND)
+    {
+    }
+    else if(ps2s->status == POST)
+    {
+    }
+    else if(ps2s->status == REC)
+    {
+    }
+    #endif
+
+    GPIOX_SET_PS2PIN(ps2s->dataport, ps2s->datapinmask);  /* ps2 data pin = 1 */
+    if(ps2s->cb_tx(NULL) && (GPIOX_IDR_PS2PIN(ps2s->dataport, ps2s->datapinmask)))
+    {                                   /* tx buffer not empty and data pin is high */
+      GPIOX_CLR_PS2PIN(ps2s->clockport, ps2s->clockpinmask); /* ps2 clock pin = 0 */
+      PS2_TIM->CNT = 0;                 /* timer counter reset */
+      PS2_TIM->CR1 |= TIM_CR1_CEN;
+      PS2_TIM_ON;                       /* timer active */
+      ps2s->status = SENDSTART;
+    }
+    else
+    {
+      GPIOX_SET_PS2PIN(ps2s->clockport, ps2s->clockpinmask); /* ps2 clock pin = 1 */
+      ps2s->status = PASSIVE;
+      PS2_TIM_OFF;
+    }
+  }
+  #if PS2_PIN_DEBUG == 1
+  GPIOX_CLR(PS2_PIN_DEBUG_2);
+  #endif
+}
+
+// ----------------------------------------------------------------------------
+/* common kbd and mouse clock EXT input (falling edge) interrupt */
+#if (PS2_KBD_EXT_N >= 1) && (PS2_MOUSE_EXT_N >= 1) && (PS2_KBD_EXT_N == PS2_MOUSE_EXT_N)
+void PS2_KBD_EXT_IRQHandler(void)
+{
+  if(EXTI_GET(PS2_KBDCLK))
+  {
+    EXTI_CLR(PS2_KBDCLK);
+    ps2_ext_int(&kbd);
+  }
+  if(EXTI_GET(PS2_MOUSECLK))
+  {
+    EXTI_CLR(PS2_MOUSECLK);
+    ps2_ext_int(&mouse);
+  }
+}
+#endif
+
+// ----------------------------------------------------------------------------
+/* keyboard clock EXT input (falling edge) interrupt */
+#if (PS2_KBD_EXT_N >= 1) && (PS2_KBD_EXT_N != PS2_MOUSE_EXT_N)
+void PS2_KBD_EXT_IRQHandler(void)
+{
+  if(EXTI_GET(PS2_KBDCLK))
+  {
+    EXTI_CLR(PS2_KBDCLK);
+    ps2_ext_int(&kbd);
+  }
+}
+#endif
+
+// ----------------------------------------------------------------------------
+/* mouse clock EXT input (falling edge) interrupt */
+#if (PS2_MOUSE_EXT_N >= 1) && (PS2_KBD_EXT_N != PS2_MOUSE_EXT_N)
+void PS2_MOUSE_EXT_IRQHandler(void)
+{
+  if(EXTI_GET(PS2_MOUSECLK))
+  {
+    EXTI_CLR(PS2_MOUSECLK);
+    ps2_ext_int(&mouse);
+  }
+}
+#endif
+
+// ----------------------------------------------------------------------------
+/* timer interrupt */
+void PS2_TIM_HANDLER(void)
+{
+  if(TIM_IRQ_GET)
+  {
+    #if (PS2_KBD_EXT_N >= 1) && (PS2_MOUSE_EXT_N >= 1)
+    if(kbd.timermode)
+    {
+      ps2_timer_int(&kbd);
+    }
+    if(mouse.timermode)
+    {
+      ps2_timer_int(&mouse);
+    }
+    #elif PS2_KBD_EXT_N >= 1
+    ps2_timer_int(&kbd);
+    #elif PS2_MOUSE_EXT_N >= 1
+    ps2_timer_int(&mouse);
+    #endif
+  }
+  TIM_IRQ_CLR;
 }
 
 // ----------------------------------------------------------------------------
@@ -772,6 +1805,10 @@ void ps2_init(void)
   NVIC->ISER[(((uint32_t)(int32_t)PS2_TIM_IRQn) >> 5UL)] = (uint32_t)(1UL << (((uint32_t)(int32_t)PS2_TIM_IRQn) & 0x1FUL));
   NVIC->IP[((uint32_t)(int32_t)PS2_TIM_IRQn)] = (uint8_t)((PS2_IRQPRIORITY << (8U - __NVIC_PRIO_BITS)) & (uint32_t)0xFFUL);
 
+  #if PS2_KBD_EXT_N >= 1
+  ps2_kbd_cmdnext();                    /* keyboard settings (scan code set, typematic, LEDs) */
+  #endif
+
   #if PS2_PIN_DEBUG > 0
   RCC_PIN_DEBUG_INIT;
   GPIOX_PPOUT(PS2_PIN_DEBUG_1);
@@ -781,220 +1818,1252 @@ void ps2_init(void)
   #endif
 }
 
-// ============================================================================
-/* high level keyboard */
-#if  PS2_KBD_EXT_N >= 1
+// ============================================================================
+/* high level keyboard */
+#if  PS2_KBD_EXT_N >= 1
+
+/* get keyboard scan code
+   - input
+     *kbd_scan: scan code pointer (if NULL -> only return the key event information, and the RX fifo buffer not modified)
+   - output
+     return: 0 = not is key event, 1 = is key event
+     *kbd_scan: keyboard scan code (if no key event occurred -> *kbd_scan not modified) */
+uint8_t ps2_kbd_getscan(uint8_t * kbd_scan)
+{
+  ps2_initcheck();
+  #if KBD_RXDECODE == 0
+  return ps2_kbd_dataread(kbd_scan);
+  #else
+  return 0;                             /* the fifo buffer holds key events (see ps2_kbd_cbrx) */
+  #endif
+}
+
+// ----------------------------------------------------------------------------
+/* scan code set 2 -> HID usage code */
+static const uint8_t ps2_kbd_set2usage[] = {
+  0x00, 0x42, 0x00, 0x3E, 0x3C, 0x3A, 0x3B, 0x45,  /* 00 */
+  0x00, 0x43, 0x41, 0x3F, 0x3D, 0x2B, 0x35, 0x00,  /* 08 */
+  0x00, 0xE2, 0xE1, 0x88, 0xE0, 0x14, 0x1E, 0x00,  /* 10 */
+  0x00, 0x00, 0x1D, 0x16, 0x04, 0x1A, 0x1F, 0x00,  /* 18 */
+  0x00, 0x06, 0x1B, 0x07, 0x08, 0x21, 0x20, 0x00,  /* 20 */
+  0x00, 0x2C, 0x19, 0x09, 0x17, 0x15, 0x22, 0x00,  /* 28 */
+  0x00, 0x11, 0x05, 0x0B, 0x0A, 0x1C, 0x23, 0x00,  /* 30 */
+  0x00, 0x00, 0x10, 0x0D, 0x18, 0x24, 0x25, 0x00,  /* 38 */
+  0x00, 0x36, 0x0E, 0x0C, 0x12, 0x27, 0x26, 0x00,  /* 40 */
+  0x00, 0x37, 0x38, 0x0F, 0x33, 0x13, 0x2D, 0x00,  /* 48 */
+  0x00, 0x87, 0x34, 0x00, 0x2F, 0x2E, 0x00, 0x00,  /* 50 */
+  0x39, 0xE5, 0x28, 0x30, 0x00, 0x31, 0x00, 0x00,  /* 58 */
+  0x00, 0x64, 0x00, 0x00, 0x8A, 0x00, 0x2A, 0x8B,  /* 60 */
+  0x00, 0x59, 0x89, 0x5C, 0x5F, 0x00, 0x00, 0x00,  /* 68 */
+  0x62, 0x63, 0x5A, 0x5D, 0x5E, 0x60, 0x29, 0x53,  /* 70 */
+  0x44, 0x57, 0x5B, 0x56, 0x55, 0x61, 0x47, 0x00,  /* 78 */
+  0x00, 0x00, 0x00, 0x40, 0x46 };                  /* 80 */
+
+/* scan code set 2 (E0 xx) -> HID usage code (E0 12 and E0 59 fake shifts -> 0) */
+static const uint8_t ps2_kbd_set2e0usage[] = {
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  /* 00 */
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  /* 08 */
+  0x00, 0xE6, 0x00, 0x00, 0xE4, 0x00, 0x00, 0x00,  /* 10 */
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xE3,  /* 18 */
+  0x00, 0x81, 0x00, 0x7F, 0x00, 0x00, 0x00, 0xE7,  /* 20 */
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x65,  /* 28 */
+  0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x66,  /* 30 */
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  /* 38 */
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  /* 40 */
+  0x00, 0x00, 0x54, 0x00, 0x00, 0x00, 0x00, 0x00,  /* 48 */
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  /* 50 */
+  0x00, 0x00, 0x58, 0x00, 0x00, 0x00, 0x00, 0x00,  /* 58 */
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  /* 60 */
+  0x00, 0x4D, 0x00, 0x50, 0x4A, 0x00, 0x00, 0x00,  /* 68 */
+  0x49, 0x4C, 0x51, 0x00, 0x4F, 0x52, 0x00, 0x00,  /* 70 */
+  0x00, 0x00, 0x4E, 0x00, 0x46, 0x4B, 0x48, 0x00 };/* 78 */
+
+#if KBD_SCANSET3 >= 1
+/* scan code set 3 -> HID usage code */
+static const uint8_t ps2_kbd_set3usage[] = {
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3A,  /* 00 */
+  0x29, 0x00, 0x00, 0x00, 0x00, 0x2B, 0x35, 0x3B,  /* 08 */
+  0x00, 0xE0, 0xE1, 0x64, 0x39, 0x14, 0x1E, 0x3C,  /* 10 */
+  0x00, 0xE2, 0x1D, 0x16, 0x04, 0x1A, 0x1F, 0x3D,  /* 18 */
+  0x00, 0x06, 0x1B, 0x07, 0x08, 0x21, 0x20, 0x3E,  /* 20 */
+  0x00, 0x2C, 0x19, 0x09, 0x17, 0x15, 0x22, 0x3F,  /* 28 */
+  0x00, 0x11, 0x05, 0x0B, 0x0A, 0x1C, 0x23, 0x40,  /* 30 */
+  0x00, 0xE6, 0x10, 0x0D, 0x18, 0x24, 0x25, 0x41,  /* 38 */
+  0x00, 0x36, 0x0E, 0x0C, 0x12, 0x27, 0x26, 0x42,  /* 40 */
+  0x00, 0x37, 0x38, 0x0F, 0x33, 0x13, 0x2D, 0x43,  /* 48 */
+  0x00, 0x00, 0x34, 0x32, 0x2F, 0x2E, 0x44, 0x46,  /* 50 */
+  0xE4, 0xE5, 0x28, 0x30, 0x31, 0x00, 0x45, 0x47,  /* 58 */
+  0x51, 0x50, 0x48, 0x52, 0x4C, 0x4D, 0x2A, 0x49,  /* 60 */
+  0x00, 0x59, 0x4F, 0x5C, 0x5F, 0x4E, 0x4A, 0x4B,  /* 68 */
+  0x62, 0x63, 0x5A, 0x5D, 0x5E, 0x60, 0x53, 0x54,  /* 70 */
+  0x00, 0x58, 0x5B, 0x00, 0x57, 0x61, 0x55, 0x00,  /* 78 */
+  0x00, 0x00, 0x00, 0x00, 0x56, 0x00, 0x00, 0x00,  /* 80 */
+  0x00, 0x00, 0x00, 0xE3, 0xE7, 0x65 };            /* 88 */
+#endif
+
+/* keymaps (index: PS2_KEYMAP_US, PS2_KEYMAP_D, PS2_KEYMAP_HU) */
+static const PS2Keymap_t * const ps2_kbd_keymaps[] = {
+  #if KEYMAP_US == 1
+  &keymap_us,
+  #else
+  NULL,
+  #endif
+  #if KEYMAP_D == 1
+  &keymap_d,
+  #else
+  NULL,
+  #endif
+  #if KEYMAP_HU == 1
+  &keymap_hu,
+  #else
+  NULL,
+  #endif
+};
+
+/* active keymap */
+#if KEYMAP_DEFAULT == PS2_KEYMAP_D
+const PS2Keymap_t * ps2_kbd_keymap = &keymap_d;
+#elif KEYMAP_DEFAULT == PS2_KEYMAP_HU
+const PS2Keymap_t * ps2_kbd_keymap = &keymap_hu;
+#else
+const PS2Keymap_t * ps2_kbd_keymap = &keymap_us;
+#endif
+
+uint8_t  ps2_kbd_decstate = 0;          /* decoder prefix status (ST_KBDBREAK, ST_KBDMODIFIER) */
+uint8_t  ps2_kbd_pausecnt = 0;          /* decoder pause sequence remaining bytes */
+volatile uint32_t ps2_kbd_keydown[8];   /* pressed keys bitmap (bit n = HID usage n, the modifiers: ps2_kbd_keydown[7] bit 0..7) */
+
+#define  PS2_KBD_HIDMODS      ((uint8_t)ps2_kbd_keydown[PS2_HID_LCTRL >> 5])
+uint8_t  ps2_kbd_lastmods = 0;          /* the modifier buttons at the last status callback */
+
+#if KBD_SWREPEAT == 1
+volatile uint8_t  ps2_kbd_repkey = 0;   /* software repeat key (HID usage, 0 = none) */
+volatile uint32_t ps2_kbd_reptime;      /* software repeat next time (ms) */
+uint16_t ps2_kbd_repdelay = KBD_SWREPEAT_DELAY;   /* first repeat delay (ms) */
+uint16_t ps2_kbd_repperiod = KBD_SWREPEAT_PERIOD; /* repeat period (ms, 0 = repeat off) */
+#endif
+
+#if KBD_HOTPLUG == 1
+// ----------------------------------------------------------------------------
+/* all keys released (keyboard reset or disconnect, the release events are not generated) */
+static void ps2_kbd_keyreset(void)
+{
+  uint32_t i;
+  for(i = 0; i < 8; i++)
+    ps2_kbd_keydown[i] = 0;
+  ps2_kbd_decstate = 0;
+  ps2_kbd_pausecnt = 0;
+  #if KBD_SWREPEAT == 1
+  ps2_kbd_repkey = 0;
+  #endif
+  if(ps2_kbd_lastmods)
+  {
+    ps2_kbd_lastmods = 0;
+    ps2_kbd_cbstatus(0, ps2_kbdlockstatus);
+  }
+}
+#endif
+
+// ----------------------------------------------------------------------------
+/* modifier buttons -> event modifier bits */
+static inline uint8_t ps2_kbd_evmods(void)
+{
+  uint8_t mods = 0;
+  uint8_t hidmods = PS2_KBD_HIDMODS;
+  if(hidmods & 0x22)                    /* Lshift, Rshift */
+    mods |= PS2_KMOD_SHIFT;
+  if(hidmods & 0x11)                    /* Lctrl, Rctrl */
+    mods |= PS2_KMOD_CTRL;
+  if(hidmods & 0x04)                    /* Lalt */
+    mods |= PS2_KMOD_ALT;
+  if(hidmods & 0x40)                    /* Ralt (altgr) */
+    mods |= PS2_KMOD_ALTGR;
+  return mods;
+}
+
+// ----------------------------------------------------------------------------
+/* HID usage -> character code (active keymap)
+   - param1: HID usage code
+   - param2: event modifier bits
+   - param3: lock status
+   - return: character code (0 = the key has no character) */
+static uint8_t ps2_kbd_keychar(uint8_t usage, uint8_t mods, uint8_t locks)
+{
+  const PS2Keymap_t * km = ps2_kbd_keymap;
+  uint8_t i, shift;
+
+  if((usage >= PS2_HID_A) && (usage <= PS2_KEYMAP_LAST))
+    i = usage - PS2_HID_A;
+  else if(usage == PS2_KEYMAP_NONUS)
+    i = PS2_KEYMAP_SIZE - 1;
+  else if((usage >= PS2_NUMKEYMAP_FIRST) && (usage < PS2_NUMKEYMAP_FIRST + sizeof(keymap_numon)) && (locks & ST_KBDNUMLOCK))
+    return keymap_numon[usage - PS2_NUMKEYMAP_FIRST]; /* numeric (numlock) */
+  else if((usage >= PS2_FIXKEYMAP_FIRST) && (usage < PS2_FIXKEYMAP_FIRST + sizeof(keymap_fix)))
+    return keymap_fix[usage - PS2_FIXKEYMAP_FIRST];   /* language independent keys */
+  else
+    return 0;
+
+  if((mods & PS2_KMOD_ALTGR) && km->altgr) /* altgr */
+    return km->altgr[i];
+
+  shift = mods & PS2_KMOD_SHIFT;
+  if((locks & ST_KBDCAPSLOCK) && (km->caps[i >> 3] & (1 << (i & 7))))
+  { /* caps lock: inverts the shift (letters) */
+    if(km->capsexc)
+    { /* exceptions */
+      const uint8_t * exc;
+      for(exc = km->capsexc; *exc != 0xFF; exc += 3)
+        if(*exc == i)
+          return shift ? exc[2] : exc[1];
+    }
+    shift = !shift;
+  }
+
+  if(shift)
+    return km->shift[i];
+  else
+    return km->noshift[i];
+}
+
+#if KBD_HOTKEYS > 0
+// ----------------------------------------------------------------------------
+/* hotkey trie (a node: one key of a hotkey sequence, the children: the next keys) */
+#define  HK_NONE              0xFF
+typedef struct
+{
+  uint8_t usage;                        /* HID usage code */
+  uint8_t mods;                         /* event modifier bits */
+  uint8_t id;                           /* hotkey id (leaf node) */
+  uint8_t child;                        /* first next key node (HK_NONE: leaf) */
+  uint8_t sibling;                      /* next node on the same level (HK_NONE: last) */
+} ps2_HkNode;
+
+ps2_HkNode ps2_kbd_hknodes[KBD_HOTKEYS];
+uint8_t  ps2_kbd_hkcnt = 0;             /* used nodes */
+uint8_t  ps2_kbd_hkroot = HK_NONE;      /* first key nodes */
+uint8_t  ps2_kbd_hkpos = HK_NONE;       /* sequence position (the last matched node, HK_NONE: root) */
+uint8_t  ps2_kbd_hkkey = HK_NONE;       /* the key of the last hotkey or sequence prefix (no repeat until the release) */
+uint32_t ps2_kbd_hkfirst[8];            /* first keys bitmap (bit n = HID usage n) */
+
+__weak  void ps2_kbd_cbhotkey(uint8_t id) { }
+
+// ----------------------------------------------------------------------------
+/* hotkey matching (key press event)
+   - the first keys are filtered with the bitmap, the next keys are searched only in the children of the last matched key
+   - return: 0 = not hotkey, 1 = sequence prefix (the event is swallowed), 2 = hotkey (*kbd_event = PS2_KEV_HOTKEY event) */
+static uint8_t ps2_kbd_hotkey(ps2_KbdEvent * kbd_event)
+{
+  uint8_t n;
+  uint8_t usage = kbd_event->usage;
+
+  while(1)
+  {
+    if(ps2_kbd_hkpos == HK_NONE)
+    {
+      if(!(ps2_kbd_hkfirst[usage >> 5] & (1UL << (usage & 0x1F))))
+        return 0;
+      n = ps2_kbd_hkroot;
+    }
+    else
+      n = ps2_kbd_hknodes[ps2_kbd_hkpos].child;
+
+    for(; n != HK_NONE; n = ps2_kbd_hknodes[n].sibling)
+    {
+      if((ps2_kbd_hknodes[n].usage == usage) && (ps2_kbd_hknodes[n].mods == kbd_event->mods))
+      {
+        if(ps2_kbd_hknodes[n].child != HK_NONE)
+        { /* sequence prefix */
+          ps2_kbd_hkpos = n;
+          return 1;
+        }
+        ps2_kbd_hkpos = HK_NONE;
+        kbd_event->type = PS2_KEV_HOTKEY;
+        kbd_event->usage = ps2_kbd_hknodes[n].id;
+        ps2_kbd_cbhotkey(ps2_kbd_hknodes[n].id);
+        return 2;
+      }
+    }
+
+    if(ps2_kbd_hkpos == HK_NONE)
+      return 0;
+    ps2_kbd_hkpos = HK_NONE;            /* the sequence broken: search again from the first keys */
+  }
+}
+#endif
+
+// ----------------------------------------------------------------------------
+/* keyboard decoder (one scan code byte at once, the prefix status is kept between the calls)
+   - param1: scan code byte
+   - param2: pointer to key event
+   - return: 0 = no finished key event, 1 = *kbd_event = key event (without character code)
+   - note: KBD_RXDECODE == 1: it is called from the keyboard RX interrupt
+           pause (E1 14 77 E1 F0 14 F0 77) -> one PS2_HID_PAUSE make event (the keyboard does not send release)
+           print screen (E0 12 E0 7C / E0 F0 7C E0 F0 12) -> one PS2_HID_PRINTSCR make and release event
+           (the E0 12 and E0 59 fake shifts are skipped)
+           make code of a pressed key -> PS2_KEV_REPEAT event (KBD_SWREPEAT == 1: dropped)
+           registered hotkey -> PS2_KEV_HOTKEY event (the sequence prefix keys: no event, no repeat until the release)
+           scan code set 3: the make only keys -> make event only (not in the pressed keys bitmap) */
+static uint8_t ps2_kbd_decode(uint8_t scan, ps2_KbdEvent * kbd_event)
+{
+  uint8_t usage;
+
+  if(ps2_kbd_pausecnt)
+  { /* pause sequence */
+    if(--ps2_kbd_pausecnt)
+      return 0;
+    usage = PS2_HID_PAUSE;
+    kbd_event->type = PS2_KEV_MAKE;
+  }
+  else
+  {
+    if(scan == 0xE1)
+    { /* pause sequence start */
+      ps2_kbd_pausecnt = 7;
+      ps2_kbd_decstate = 0;
+      return 0;
+    }
+    if(scan == 0xE0)
+    { /* two bytes scan code */
+      ps2_kbd_decstate |= ST_KBDMODIFIER;
+      return 0;
+    }
+    if(scan == 0xF0)
+    { /* key release */
+      ps2_kbd_decstate |= ST_KBDBREAK;
+      return 0;
+    }
+    if((scan == 0xFA) || (scan == 0xAA) || (scan == 0xEE) || (scan == 0xFE) || (scan == 0xFC) || (scan == 0x00) || (scan == 0xFF))
+    { /* keyboard answers (ACK, BAT, echo, resend, errors) */
+      #if KBD_HOTPLUG == 1
+      if(scan == 0xAA)
+        ps2_kbd_keyreset();             /* BAT: the keyboard has been reset (plugged in) */
+      #endif
+      ps2_kbd_decstate = 0;
+      return 0;
+    }
+
+    #if KBD_SCANSET3 >= 1
+    if(ps2_kbd_scanset == 3)
+      usage = (scan < sizeof(ps2_kbd_set3usage)) ? ps2_kbd_set3usage[scan] : 0;
+    else
+    #endif
+    if(ps2_kbd_decstate & ST_KBDMODIFIER)
+      usage = (scan < sizeof(ps2_kbd_set2e0usage)) ? ps2_kbd_set2e0usage[scan] : 0;
+    else
+      usage = (scan < sizeof(ps2_kbd_set2usage)) ? ps2_kbd_set2usage[scan] : 0;
+
+    kbd_event->type = (ps2_kbd_decstate & ST_KBDBREAK) ? PS2_KEV_BREAK : PS2_KEV_MAKE;
+    ps2_kbd_decstate = 0;               /* BREAK/MODIFIER status off */
+    if(usage == 0)
+      return 0;                         /* unknown key or fake shift */
+  }
+
+  if(usage != PS2_HID_PAUSE)
+  { /* pressed keys bitmap (also the modifier buttons), the pause has no release */
+    if(kbd_event->type == PS2_KEV_BREAK)
+      ps2_kbd_keydown[usage >> 5] &= ~(1UL << (usage & 0x1F));
+    else if(ps2_kbd_keydown[usage >> 5] & (1UL << (usage & 0x1F)))
+    { /* make code of a pressed key: keyboard typematic repeat */
+      #if KBD_SWREPEAT == 1
+      return 0;                         /* software repeat: the keyboard repeats are dropped */
+      #else
+      kbd_event->type = PS2_KEV_REPEAT;
+      #endif
+    }
+    else if(!SCN_MAKEONLY(usage))
+    { /* not the set 3 make only key (no release, not in the bitmap) */
+      ps2_kbd_keydown[usage >> 5] |= 1UL << (usage & 0x1F);
+      #if KBD_SWREPEAT == 1
+      if((usage < PS2_HID_LCTRL) && (usage != PS2_HID_CAPSLOCK) && (usage != PS2_HID_NUMLOCK) && (usage != PS2_HID_SCRLOCK))
+      { /* the last pressed key repeats (not the modifiers and the locks) */
+        ps2_kbd_repkey = usage;
+        ps2_kbd_reptime = PS2_GETTIME() + ps2_kbd_repdelay;
+      }
+      #endif
+    }
+  }
+
+  kbd_event->usage = usage;
+  kbd_event->mods = ps2_kbd_evmods();
+  kbd_event->locks = ps2_kbdlockstatus;
+
+  if(PS2_KBD_HIDMODS != ps2_kbd_lastmods)
+  { /* modifier button changed */
+    ps2_kbd_lastmods = PS2_KBD_HIDMODS;
+    ps2_kbd_cbstatus(ps2_kbd_lastmods, ps2_kbdlockstatus);
+  }
+
+  #if KBD_HOTKEYS > 0
+  if(usage == ps2_kbd_hkkey)
+  { /* the key of a hotkey or sequence prefix: the repeats are dropped until the release */
+    if(kbd_event->type == PS2_KEV_REPEAT)
+      return 0;
+    ps2_kbd_hkkey = HK_NONE;
+  }
+  if((kbd_event->type == PS2_KEV_MAKE) && (usage < PS2_HID_LCTRL))
+  {
+    uint8_t hk = ps2_kbd_hotkey(kbd_event);
+    if(hk)
+    {
+      ps2_kbd_hkkey = usage;
+      #if KBD_SWREPEAT == 1
+      ps2_kbd_repkey = 0;               /* no software repeat */
+      #endif
+      if(hk == 1)
+        return 0;
+    }
+  }
+  #endif
+  return 1;
+}
+
+// ----------------------------------------------------------------------------
+/* key event character code (make, repeat: keymap, break, hotkey: 0) */
+static inline void ps2_kbd_evchar(ps2_KbdEvent * kbd_event)
+{
+  if(((kbd_event->type == PS2_KEV_MAKE) || (kbd_event->type == PS2_KEV_REPEAT)) && (kbd_event->usage < PS2_HID_LCTRL))
+    kbd_event->ch = ps2_kbd_keychar(kbd_event->usage, kbd_event->mods, kbd_event->locks);
+  else
+    kbd_event->ch = 0;
+}
+
+// ----------------------------------------------------------------------------
+/* software repeat (the last pressed key is still pressed and the repeat time elapsed)
+   - param: pointer to key event (NULL: only check)
+   - return: 0 = no repeat (or KBD_SWREPEAT == 0), 1 = *kbd_event = PS2_KEV_REPEAT event */
+static uint8_t ps2_kbd_swrepeat(ps2_KbdEvent * kbd_event)
+{
+  #if KBD_SWREPEAT == 1
+  uint32_t primask, t;
+  uint8_t  usage = ps2_kbd_repkey;
+
+  if((usage == 0) || (ps2_kbd_repperiod == 0) || !ps2_kbd_iskeydown(usage))
+    return 0;
+  t = PS2_GETTIME();
+  if((int32_t)(t - ps2_kbd_reptime) < 0)
+    return 0;
+
+  if(kbd_event)
+  {
+    primask = __get_PRIMASK();
+    __disable_irq();
+    if(usage == ps2_kbd_repkey)
+    { /* next repeat time (if it was late: from now) */
+      ps2_kbd_reptime += ps2_kbd_repperiod;
+      if((int32_t)(t - ps2_kbd_reptime) >= 0)
+        ps2_kbd_reptime = t + ps2_kbd_repperiod;
+    }
+    __set_PRIMASK(primask);
+    kbd_event->type = PS2_KEV_REPEAT;
+    kbd_event->usage = usage;
+    kbd_event->mods = ps2_kbd_evmods();
+    kbd_event->locks = ps2_kbdlockstatus;
+  }
+  return 1;
+  #else
+  return 0;
+  #endif
+}
+
+// ----------------------------------------------------------------------------
+/* decoded key events lookahead buffer (ps2_kbd_getevent, ps2_kbd_getkey, ps2_kbd_peek, ps2_kbd_available) */
+struct kbdbuf_k
+{
+  uint32_t in;                /* Next In Index */
+  uint32_t out;               /* Next Out Index */
+  ps2_KbdEvent data[KBDKBUF_SIZE]; /* Buffer data (decoded key events) */
+};
+
+static struct kbdbuf_k kbdkbuf = {0, 0,};
+
+#define KEV_ISCHAR(e)     (((e).type != PS2_KEV_BREAK) && (e).ch) /* key event with character (press, repeat) */
+
+// ----------------------------------------------------------------------------
+/* next key event from the keyboard RX buffer (or software repeat), decoded once
+   - return: 0 = no key event, 1 = *kbd_event = key event (with the character code) */
+static uint8_t ps2_kbd_evread(ps2_KbdEvent * kbd_event)
+{
+  #if KBD_RXDECODE == 0
+  uint8_t ps2_kbd_s;
+
+  while(1)
+  {
+    if(ps2_kbd_dataread(&ps2_kbd_s) == 0)
+    {
+      if(ps2_kbd_swrepeat(kbd_event))
+        break;
+      return 0;                         /* the keyboard buffer is empty */
+    }
+    if(ps2_kbd_decode(ps2_kbd_s, kbd_event))
+      break;
+  }
+
+  #elif KBD_RXDECODE == 1
+  uint16_t ps2_kbd_kev;
+  #if KBD_SCANNER == 2
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  ps2_kbd_scanpoll();                   /* the held human key events -> RX fifo */
+  __set_PRIMASK(primask);
+  #elif KBD_MAGSTRIPE == 1
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  ps2_kbd_magpoll();                    /* the held start sentinel -> RX fifo, end of the card */
+  __set_PRIMASK(primask);
+  #endif
+
+  if(FIFO_NOTEMPTY(kbdrbuf))
+  {
+    FIFO_READ(kbdrbuf, KBDRBUF_SIZE, ps2_kbd_kev);
+    kbd_event->usage = KEV_USAGE(ps2_kbd_kev);
+    kbd_event->type = KEV_TYPE(ps2_kbd_kev);
+    kbd_event->mods = KEV_MODS(ps2_kbd_kev);
+    kbd_event->locks = KEV_LOCKS(ps2_kbd_kev) | (ps2_kbdlockstatus & ST_KBDSCRLOCK);
+  }
+  else if(!ps2_kbd_swrepeat(kbd_event))
+    return 0;                           /* the keyboard buffer is empty, no software repeat */
+  #endif
+
+  ps2_kbd_evchar(kbd_event);
+  return 1;
+}
+
+// ----------------------------------------------------------------------------
+/* decode the key events into the lookahead buffer (until it is full or there are no more key events)
+   - kbd_chars = 0: until kbd_n key events, 1: until kbd_n character key events
+   - return: key events (kbd_chars = 0) or character key events (kbd_chars = 1) in the lookahead buffer */
+static uint32_t ps2_kbd_evfill(uint32_t kbd_n, uint8_t kbd_chars)
+{
+  uint32_t i, n = FIFO_LEN(kbdkbuf);
+
+  ps2_initcheck();
+  ps2_kbd_cmdpoll();                    /* keyboard command timeout, settings */
+
+  if(kbd_chars)
+  {
+    n = 0;
+    for(i = kbdkbuf.out; i != kbdkbuf.in; i++)
+      n += KEV_ISCHAR(kbdkbuf.data[i & (KBDKBUF_SIZE - 1)]) ? 1 : 0;
+  }
+  while((n < kbd_n) && FIFO_NOTFULL(kbdkbuf, KBDKBUF_SIZE))
+  {
+    if(ps2_kbd_evread(&kbdkbuf.data[kbdkbuf.in & (KBDKBUF_SIZE - 1)]) == 0)
+      break;
+    if(!kbd_chars || KEV_ISCHAR(kbdkbuf.data[kbdkbuf.in & (KBDKBUF_SIZE - 1)]))
+      n++;
+    kbdkbuf.in++;
+  }
+  return n;
+}
+
+// ----------------------------------------------------------------------------
+/* Get keyboard event
+   - input
+     *kbd_event: key event pointer (if NULL -> only return the key event information, and the event stays in the buffer)
+   - output
+     return: 0 = no key event, 1 = key event
+     *kbd_event: key event (if no key event occurred -> *kbd_event not modified) */
+uint8_t ps2_kbd_getevent(ps2_KbdEvent * kbd_event)
+{
+  uint8_t ret = 0;
+
+  #if PS2_PIN_DEBUG == 2
+  GPIOX_SET(PS2_PIN_DEBUG_1);
+  #endif
+
+  if(ps2_kbd_evfill(1, 0))
+  {
+    if(kbd_event)
+      FIFO_READ(kbdkbuf, KBDKBUF_SIZE, *kbd_event);
+    ret = 1;
+  }
+
+  #if PS2_PIN_DEBUG == 2
+  GPIOX_CLR(PS2_PIN_DEBUG_1);
+  #endif
+  return ret;
+}
+
+// ----------------------------------------------------------------------------
+/* Get keyboard asc code
+   - input
+     *kbd_key: asc code pointer (if NULL -> only return the key pressed information, the character stays in the buffer)
+   - output
+     return: 0 = no key pressed, 1 = key pressed
+     *kbd_key: keyboard asc code (if no key event occurred -> *kbd_key not modified)
+   - note: the key releases and the keys without character code (modifiers, locks) are skipped (removed) */
+uint8_t ps2_kbd_getkey(uint8_t * kbd_key)
+{
+  while(ps2_kbd_evfill(1, 0))
+  {
+    if(KEV_ISCHAR(kbdkbuf.data[kbdkbuf.out & (KBDKBUF_SIZE - 1)]))
+    {
+      if(kbd_key)
+        *kbd_key = kbdkbuf.data[kbdkbuf.out++ & (KBDKBUF_SIZE - 1)].ch;
+      return 1;
+    }
+    kbdkbuf.out++;                      /* not a character */
+  }
+  return 0;
+}
+
+// ----------------------------------------------------------------------------
+/* Get the number of the decoded characters (the waiting key events are decoded until the lookahead buffer is full)
+   - output
+     return: number of the characters that ps2_kbd_getkey / ps2_kbd_peek can get without waiting */
+uint32_t ps2_kbd_available(void)
+{
+  return ps2_kbd_evfill(KBDKBUF_SIZE, 1);
+}
+
+// ----------------------------------------------------------------------------
+/* Look ahead: the n. character (0 = the next ps2_kbd_getkey character) without removing it
+   - the key events stay in the buffer for ps2_kbd_getevent too
+   - input
+     kbd_n: character index (0 .. KBDKBUF_SIZE - 1)
+   - output
+     return: asc code (0 = there are no n + 1 characters yet) */
+uint8_t ps2_kbd_peek(uint32_t kbd_n)
+{
+  uint32_t i;
+  if(ps2_kbd_evfill(kbd_n + 1, 1) <= kbd_n)
+    return 0;
+  for(i = kbdkbuf.out; ; i++)
+  {
+    if(KEV_ISCHAR(kbdkbuf.data[i & (KBDKBUF_SIZE - 1)]) && (kbd_n-- == 0))
+      return kbdkbuf.data[i & (KBDKBUF_SIZE - 1)].ch;
+  }
+}
+
+// ----------------------------------------------------------------------------
+/* is it a language independent control key (F1..F12, arrows, page up/down, insert, delete, home, end)
+   - not a keymap plane key, not a printable keypad character, not the keypad enter
+   - its character code may be equal to a codepage character (e.g. PS2_END = 0x9F) */
+static uint8_t ps2_kbd_isctrlkey(const ps2_KbdEvent * kbd_event)
+{
+  uint8_t ch = kbd_event->ch;
+  return (kbd_event->usage > PS2_KEYMAP_LAST) && (kbd_event->usage != PS2_KEYMAP_NONUS) &&
+         (ch != PS2_ENTER) && ((ch < ' ') || (ch >= 0x7F));
+}
+
+// ----------------------------------------------------------------------------
+/* key event character code -> unicode (active keymap)
+   - the typed characters (keymap planes) are converted with the keymap codepage table
+   - the language independent control keys -> PS2_UNI_KEY(code) (enter, tab, backspace, esc: keymap) */
+static uint32_t ps2_kbd_unicode(const ps2_KbdEvent * kbd_event)
+{
+  uint8_t ch = kbd_event->ch;
+  if(ps2_kbd_isctrlkey(kbd_event))
+    return PS2_UNI_KEY(ch);
+  if(ch < 0x80)
+    return ch;
+  if(ps2_kbd_keymap->unicode)
+    return ps2_kbd_keymap->unicode[ch - 0x80];
+  return ch;
+}
+
+// ----------------------------------------------------------------------------
+/* is it a dead key (active keymap) */
+static uint8_t ps2_kbd_isdeadkey(const ps2_KbdEvent * kbd_event)
+{
+  const uint8_t * dk = ps2_kbd_keymap->deadkeys;
+  if((dk == NULL) || ((kbd_event->usage > PS2_KEYMAP_LAST) && (kbd_event->usage != PS2_KEYMAP_NONUS)))
+    return 0;
+  while(*dk)
+  {
+    if(*dk++ == kbd_event->ch)
+      return 1;
+  }
+  return 0;
+}
+
+// ----------------------------------------------------------------------------
+/* dead key + character -> composed unicode (0 = not composable) */
+static uint32_t ps2_kbd_compose(uint32_t dead, uint32_t ch)
+{
+  #if (KEYMAP_UNICODE == 1) && ((KEYMAP_D == 1) || (KEYMAP_HU == 1))
+  uint32_t i;
+  for(i = 0; i < sizeof(keymap_compose) / sizeof(keymap_compose[0]); i++)
+  {
+    if((keymap_compose[i][0] == dead) && (keymap_compose[i][1] == ch))
+      return keymap_compose[i][2];
+  }
+  #endif
+  return 0;
+}
 
-/* get keyboard scan code
+// ----------------------------------------------------------------------------
+/* Get keyboard unicode character
    - input
-     *kbd_scan: scan code pointer (if NULL -> only return the key event information, and the RX fifo buffer not modified)
+     *kbd_char: unicode character pointer (if NULL -> only return the key pressed information, and the character is stored for the next query)
    - output
-     return: 0 = not is key event, 1 = is key event
-     *kbd_scan: keyboard scan code (if no key event occurred -> *kbd_scan not modified) */
-uint8_t ps2_kbd_getscan(uint8_t * kbd_scan)
+     return: 0 = no character, 1 = character
+     *kbd_char: unicode code point (if no character -> *kbd_char not modified)
+   - note: the dead keys (see the keymap deadkeys in ps2_codepage.h) are waiting for the next character:
+           dead key + composable character -> composed character (e.g. acute + e -> U+00E9)
+           dead key + space -> the dead key character
+           dead key + other character (or other dead key) -> the dead key character, and the next query the character */
+uint8_t ps2_kbd_getchar32(uint32_t * kbd_char)
 {
-  ps2_initcheck();
-  return ps2_kbd_dataread(kbd_scan);
+  static uint32_t ps2_kbd_u = 0, ps2_kbd_us = 0;
+  static uint32_t ps2_kbd_dead = 0;     /* waiting dead key (0 = none) */
+  static uint32_t ps2_kbd_next = 0;     /* not composable character after the dead key (0 = none) */
+  ps2_KbdEvent ps2_kbd_e;
+  uint32_t u;
+
+  if(!ps2_kbd_us)
+  {
+    if(ps2_kbd_next)
+    {
+      ps2_kbd_u = ps2_kbd_next;
+      ps2_kbd_next = 0;
+    }
+    else
+    {
+      while(1)
+      {
+        if(ps2_kbd_getevent(&ps2_kbd_e) == 0)
+          return 0;
+        if((ps2_kbd_e.type == PS2_KEV_BREAK) || (ps2_kbd_e.ch == 0))
+          continue;
+        u = ps2_kbd_unicode(&ps2_kbd_e);
+        if(u == 0)
+          continue;                     /* not defined in the codepage */
+        if(ps2_kbd_isdeadkey(&ps2_kbd_e))
+        {
+          if(ps2_kbd_dead == 0)
+          { /* wait for the next character */
+            ps2_kbd_dead = u;
+            continue;
+          }
+          ps2_kbd_u = ps2_kbd_dead;     /* two dead keys: the first is printed, the second waits */
+          ps2_kbd_dead = u;
+          break;
+        }
+        if(ps2_kbd_dead)
+        {
+          ps2_kbd_u = ps2_kbd_compose(ps2_kbd_dead, u);
+          if(ps2_kbd_u == 0)
+          {
+            ps2_kbd_u = ps2_kbd_dead;
+            if(u != ' ')
+              ps2_kbd_next = u;
+          }
+          ps2_kbd_dead = 0;
+        }
+        else
+          ps2_kbd_u = u;
+        break;
+      }
+    }
+    ps2_kbd_us = 1;
+  }
+
+  if(kbd_char)
+  {
+    *kbd_char = ps2_kbd_u;
+    ps2_kbd_us = 0;
+  }
+  return 1;
 }
 
 // ----------------------------------------------------------------------------
-/* Get keyboard asc code
+/* Get keyboard character in UTF-8
    - input
-     *kbd_key: asc code pointer (if NULL -> only return the key pressed information, and the RX fifo buffer not modified)
+     *kbd_utf8: UTF-8 buffer pointer (min. 4 bytes, not 0 terminated; if NULL -> as ps2_kbd_getchar32(NULL))
    - output
-     return: 0 = no key pressed, 1 = key pressed
-     *kbd_key: keyboard asc code (if no key event occurred -> *kbd_key not modified) */
-uint8_t ps2_kbd_getkey(uint8_t * kbd_key)
+     return: 0 = no character, 1..4 = UTF-8 byte count in *kbd_utf8 */
+uint8_t ps2_kbd_getutf8(uint8_t * kbd_utf8)
 {
-  static uint8_t state = 0, ps2_kbd_c = 0, ps2_kbd_cs = 0;
-  uint8_t ps2_kbd_s;
-
-  #if PS2_PIN_DEBUG == 2
-  GPIOX_SET(PS2_PIN_DEBUG_1);
-  #endif
+  uint32_t u;
 
-  ps2_initcheck();
+  if(kbd_utf8 == NULL)
+    return ps2_kbd_getchar32(NULL);
+  if(ps2_kbd_getchar32(&u) == 0)
+    return 0;
 
-  if(ps2_kbd_cs)
-  { /* stored query (previous query: only key pressed information) */
-    if(kbd_key)
-    {
-      *kbd_key = ps2_kbd_c;
-      ps2_kbd_cs = 0;
-    }
-    #if PS2_PIN_DEBUG == 2
-    GPIOX_CLR(PS2_PIN_DEBUG_1);
-    #endif
+  if(u < 0x80)
+  {
+    kbd_utf8[0] = u;
     return 1;
   }
+  else if(u < 0x800)
+  {
+    kbd_utf8[0] = 0xC0 | (u >> 6);
+    kbd_utf8[1] = 0x80 | (u & 0x3F);
+    return 2;
+  }
+  else if(u < 0x10000)
+  {
+    kbd_utf8[0] = 0xE0 | (u >> 12);
+    kbd_utf8[1] = 0x80 | ((u >> 6) & 0x3F);
+    kbd_utf8[2] = 0x80 | (u & 0x3F);
+    return 3;
+  }
+  kbd_utf8[0] = 0xF0 | (u >> 18);
+  kbd_utf8[1] = 0x80 | ((u >> 12) & 0x3F);
+  kbd_utf8[2] = 0x80 | ((u >> 6) & 0x3F);
+  kbd_utf8[3] = 0x80 | (u & 0x3F);
+  return 4;
+}
 
-  while(1)
+// ----------------------------------------------------------------------------
+/* Line input init
+   - input
+     kbd_line: line input state
+     kbd_buf: line buffer (the line is edited here, no copy)
+     kbd_size: line buffer size (max. kbd_size - 1 characters + 0 terminator) */
+void ps2_kbd_lineinit(ps2_KbdLine * kbd_line, uint8_t * kbd_buf, uint32_t kbd_size)
+{
+  kbd_line->buf = kbd_buf;
+  kbd_line->size = kbd_size;
+  kbd_line->len = 0;
+  kbd_line->pos = 0;
+  kbd_line->ovr = 0;
+  kbd_line->done = 0;
+  if(kbd_size)
+    kbd_buf[0] = 0;
+}
+
+// ----------------------------------------------------------------------------
+/* Line input (the waiting key events are edited into the line buffer)
+   - input
+     kbd_line: line input state (see ps2_kbd_lineinit)
+   - output
+     return: NULL = the line is not complete, else: the line buffer (0 terminated, without the enter)
+     *kbd_len: line length (if the line is complete)
+   - note: editing keys: backspace, delete, left, right, home, end, insert (insert / overwrite), esc (clear line)
+           the next call after the complete line starts a new line in the same buffer
+           do not mix with ps2_kbd_getkey (the characters in the lookahead buffer are not seen here) */
+uint8_t * ps2_kbd_getline(ps2_KbdLine * kbd_line, uint32_t * kbd_len)
+{
+  ps2_KbdEvent ps2_kbd_e;
+  uint8_t * b = kbd_line->buf;
+  uint32_t i;
+
+  if(kbd_line->size == 0)
+    return NULL;
+  if(kbd_line->done)
+  { /* new line */
+    kbd_line->len = 0;
+    kbd_line->pos = 0;
+    kbd_line->done = 0;
+    b[0] = 0;
+  }
+
+  while(ps2_kbd_getevent(&ps2_kbd_e))
   {
-    if(ps2_kbd_dataread(&ps2_kbd_s) == 0)
+    if(((ps2_kbd_e.type != PS2_KEV_MAKE) && (ps2_kbd_e.type != PS2_KEV_REPEAT)) || (ps2_kbd_e.ch == 0))
+      continue;
+    if(ps2_kbd_e.usage == PS2_HID_BACKSPACE)
     {
-      #if PS2_PIN_DEBUG == 2
-      GPIOX_CLR(PS2_PIN_DEBUG_1);
-      #endif
-      return 0;                         /* nincs a billenty pufferben semmi */
+      if(kbd_line->pos)
+      {
+        kbd_line->pos--;
+        for(i = kbd_line->pos; i < kbd_line->len; i++)
+          b[i] = b[i + 1];              /* with the terminator */
+        kbd_line->len--;
+      }
     }
-    if(ps2_kbd_s == 0xE0)
-    { /* kt bjtos karakter */
-      state |= ST_KBDMODIFIER;
-      if(ps2_kbd_dataread(&ps2_kbd_s) == 0)
+    else if(ps2_kbd_isctrlkey(&ps2_kbd_e))
+    { /* the editing keys by the key (the codes may be codepage characters) */
+      if(ps2_kbd_e.ch == PS2_DELETE)
       {
-        #if PS2_PIN_DEBUG == 2
-        GPIOX_CLR(PS2_PIN_DEBUG_1);
-        #endif
-        return 0;
+        if(kbd_line->pos < kbd_line->len)
+        {
+          for(i = kbd_line->pos; i < kbd_line->len; i++)
+            b[i] = b[i + 1];
+          kbd_line->len--;
+        }
+      }
+      else if(ps2_kbd_e.ch == PS2_LEFTARROW)
+      {
+        if(kbd_line->pos)
+          kbd_line->pos--;
+      }
+      else if(ps2_kbd_e.ch == PS2_RIGHTARROW)
+      {
+        if(kbd_line->pos < kbd_line->len)
+          kbd_line->pos++;
       }
+      else if(ps2_kbd_e.ch == PS2_HOME)
+        kbd_line->pos = 0;
+      else if(ps2_kbd_e.ch == PS2_END)
+        kbd_line->pos = kbd_line->len;
+      else if(ps2_kbd_e.ch == PS2_INSERT)
+        kbd_line->ovr ^= 1;
+    }
+    else if(ps2_kbd_e.ch == PS2_ESC)
+    {
+      kbd_line->len = 0;
+      kbd_line->pos = 0;
+      b[0] = 0;
+    }
+    else if(ps2_kbd_e.ch == PS2_ENTER)
+    {
+      kbd_line->done = 1;
+      if(kbd_len)
+        *kbd_len = kbd_line->len;
+      return b;
     }
-    if(ps2_kbd_s == 0xF0)
-    { /* gomb felengeds */
-      state |= ST_KBDBREAK;
-      if(ps2_kbd_dataread(&ps2_kbd_s) == 0)
+    else if(ps2_kbd_e.ch >= ' ')
+    { /* character (keymap plane or keypad, codepage 0x80..0xFF too) */
+      if(kbd_line->ovr && (kbd_line->pos < kbd_line->len))
+        b[kbd_line->pos++] = ps2_kbd_e.ch;
+      else if(kbd_line->len < kbd_line->size - 1)
       {
-        #if PS2_PIN_DEBUG == 2
-        GPIOX_CLR(PS2_PIN_DEBUG_1);
-        #endif
-        return 0;
+        for(i = kbd_line->len + 1; i > kbd_line->pos; i--)
+          b[i] = b[i - 1];              /* with the terminator */
+        b[kbd_line->pos++] = ps2_kbd_e.ch;
+        kbd_line->len++;
       }
     }
+  }
+  return NULL;
+}
 
-    if(state & ST_KBDBREAK)
-    { /* gomb felengeds sttusz */
-      if(ps2_kbd_s == 0x12)
-        state &= ~ST_KBDSHIFT_L;
-      else if(ps2_kbd_s == 0x59)
-        state &= ~ST_KBDSHIFT_R;
-      else if(ps2_kbd_s == 0x14)
-        state &= ~ST_KBDCTRL;
-      else if(ps2_kbd_s == 0x11 && (state & ST_KBDMODIFIER))
-        state &= ~ST_KBDALTGR;
-      state &= ~(ST_KBDBREAK | ST_KBDMODIFIER); /* BREAK/MODIFIER sttusz ki */
-    }
+// ----------------------------------------------------------------------------
+/* Get barcode scanner string
+   - input
+     *kbd_str: string buffer pointer (if NULL -> only return the string length, and the string is not removed)
+     kbd_len: string buffer size (the longer string is truncated to kbd_len - 1 characters)
+   - output
+     return: 0 = no string, n = string length
+     *kbd_str: 0 terminated string (without the terminator character)
+   - note: a string is complete after the terminator character (KBD_SCANNER_TERM1, KBD_SCANNER_TERM2)
+           or if no character came in KBD_SCANNER_TIMEOUT time
+           KBD_SCANNER == 2: only the runs classified as scanner, the human key events -> ps2_kbd_getevent */
+uint32_t ps2_kbd_getstring(uint8_t * kbd_str, uint32_t kbd_len)
+{
+  #if KBD_SCANNER >= 1
+  uint32_t n, i;
+  uint32_t primask = __get_PRIMASK();
+
+  ps2_initcheck();
+
+  __disable_irq();
+  ps2_kbd_scanpoll();                   /* inter character timeout */
+  __set_PRIMASK(primask);
+
+  if(FIFO_EMPTY(scanbuf))
+    return 0;
+
+  for(n = 0; scanbuf.data[(scanbuf.out + n) & (KBD_SCANNER_BUFSIZE - 1)]; n++);
+  if(kbd_str == NULL)
+    return n;
+  if(kbd_len == 0)
+    return 0;                           /* no space (the string remains in the buffer) */
+
+  for(i = 0; i <= n; i++)
+  {
+    if(i + 1 < kbd_len)
+      FIFO_READ(scanbuf, KBD_SCANNER_BUFSIZE, kbd_str[i]);
     else
-    {                                   /* gomb lenyoms vagy ismtls */
-      if(state & ST_KBDMODIFIER)
-      {                                 /* kt bjtos (MODIFIER) gombok (INS, DEL, 4 nyil stb.) */
-        if(ps2_kbd_s == 0x11)
-        {
-          state |= ST_KBDALTGR;         /* E0 11 */
-          continue;
-        }
-        else if(ps2_kbd_s == 0x14)
-        {
-          state |= ST_KBDCTRL;          /* E0 14 */
-          continue;
-        }
-        switch(ps2_kbd_s)
-        {
-          case 0x70: ps2_kbd_c = PS2_INSERT;     break;
-          case 0x6C: ps2_kbd_c = PS2_HOME;       break;
-          case 0x7D: ps2_kbd_c = PS2_PAGEUP;     break;
-          case 0x71: ps2_kbd_c = PS2_DELETE;     break;
-          case 0x69: ps2_kbd_c = PS2_END;        break;
-          case 0x7A: ps2_kbd_c = PS2_PAGEDOWN;   break;
-          case 0x75: ps2_kbd_c = PS2_UPARROW;    break;
-          case 0x6B: ps2_kbd_c = PS2_LEFTARROW;  break;
-          case 0x72: ps2_kbd_c = PS2_DOWNARROW;  break;
-          case 0x74: ps2_kbd_c = PS2_RIGHTARROW; break;
-          case 0x4A: ps2_kbd_c = '/';            break;
-          case 0x5A: ps2_kbd_c = PS2_ENTER;      break;
-          default: break;
-        }
-        if(kbd_key)
-        {
-          *kbd_key = ps2_kbd_c;
-        }
-        else
-        {
-          ps2_kbd_cs = 1;
-        }
-        #if PS2_PIN_DEBUG == 2
-        GPIOX_CLR(PS2_PIN_DEBUG_1);
-        #endif
-        return 1;
-      }
-      else
-      {                            /* nincs MODIFIER (egy bjtos kd) */
-        if(ps2_kbd_s == 0x12)
-        {
-          state |= ST_KBDSHIFT_L;
-          continue;
-        }
-        else if(ps2_kbd_s == 0x59)
-        {
-          state |= ST_KBDSHIFT_R;
-          continue;
-        }
-        else if(ps2_kbd_s == 0x14)
-        {
-          state |= ST_KBDCTRL;
-          continue;
-        }
-        if(ps2_kbd_s <= PS2_MAINKEYMAP_SIZE)
-        {
-          if((state & ST_KBDALTGR) && keymap.uses_altgr) /* altgr */
-            ps2_kbd_c = keymap.altgr[ps2_kbd_s];
-          else if(state & (ST_KBDSHIFT_L | ST_KBDSHIFT_R))
-          { /* shift */
-            if(ps2_kbdlockstatus & ST_KBDCAPSLOCK)
-              ps2_kbd_c = keymap.shiftcaps[ps2_kbd_s];
-            else
-              ps2_kbd_c = keymap.shift[ps2_kbd_s];
-          }
-          else
-          {
-            if(ps2_kbdlockstatus & ST_KBDCAPSLOCK)
-              ps2_kbd_c = keymap.noshiftcaps[ps2_kbd_s];
-            else
-              ps2_kbd_c = keymap.noshift[ps2_kbd_s];
-          }
-        }
-        else if(ps2_kbd_s <= (PS2_MAINKEYMAP_SIZE + PS2_NUMKEYMAP_SIZE))
-        { /* numerikus */
-          if(ps2_kbdlockstatus & ST_KBDNUMLOCK)
-            ps2_kbd_c = keymap.numon[ps2_kbd_s - PS2_MAINKEYMAP_SIZE];
-          else
-            ps2_kbd_c = keymap.numoff[ps2_kbd_s - PS2_MAINKEYMAP_SIZE];
-        }
-        if(kbd_key)
-        {
-          *kbd_key = ps2_kbd_c;
-        }
-        else
-        {
-          ps2_kbd_cs = 1;
-        }
-        #if PS2_PIN_DEBUG == 2
-        GPIOX_CLR(PS2_PIN_DEBUG_1);
-        #endif
-        return 1;
-      } /* else (state & MODIFIER) */
-    } /* else (state & BREAK) */
-  } /*  while(1) */
+      scanbuf.out++;                    /* truncated */
+  }
+  kbd_str[(n < kbd_len) ? n : kbd_len - 1] = 0;
+  return (n < kbd_len) ? n : kbd_len - 1;
+  #else
+  return 0;
+  #endif
+}
+
+// ----------------------------------------------------------------------------
+/* Get magnetic stripe card
+   - input
+     *kbd_card: card pointer (if NULL -> only return the card ready information, and the card is not removed)
+   - output
+     return: 0 = no card, 1 = card
+     *kbd_card: the tracks (0 terminated, without the sentinels and LRC) and the track status (PS2_TRACK_...)
+   - note: the card is complete after the enter or if no character came in KBD_MAGSTRIPE_TIMEOUT time */
+uint8_t ps2_kbd_getcard(ps2_KbdCard * kbd_card)
+{
+  #if KBD_MAGSTRIPE == 1
+  uint32_t primask = __get_PRIMASK();
+
+  ps2_initcheck();
+
+  __disable_irq();
+  ps2_kbd_magpoll();                    /* inter character timeout */
+  __set_PRIMASK(primask);
+
+  if(!ps2_kbd_magready)
+    return 0;
+  if(kbd_card)
+  {
+    *kbd_card = ps2_kbd_magcard;
+    ps2_kbd_magready = 0;
+  }
+  return 1;
+  #else
+  return 0;
+  #endif
+}
+
+// ----------------------------------------------------------------------------
+/* Is the key pressed
+   - input
+     kbd_usage: HID usage code (see the keyboard HID usage codes)
+   - output
+     return: 0 = released, 1 = pressed
+   - note: the bitmap is updated when the scan codes are decoded (ps2_kbd_getevent, ps2_kbd_getkey) */
+uint8_t ps2_kbd_iskeydown(uint8_t kbd_usage)
+{
+  return (ps2_kbd_keydown[kbd_usage >> 5] >> (kbd_usage & 0x1F)) & 1;
+}
+
+// ----------------------------------------------------------------------------
+/* Get the pressed keys bitmap (atomic snapshot)
+   - input
+     *kbd_keys: pointer to 8 x 32 bits (32 bytes) array
+   - output
+     *kbd_keys: pressed keys bitmap (bit n = HID usage n, kbd_keys[n >> 5] bit (n & 31)) */
+void ps2_kbd_getkeydown(uint32_t * kbd_keys)
+{
+  uint32_t primask = __get_PRIMASK();
+  uint32_t i;
+  __disable_irq();
+  for(i = 0; i < 8; i++)
+    kbd_keys[i] = ps2_kbd_keydown[i];
+  __set_PRIMASK(primask);
+}
+
+// ----------------------------------------------------------------------------
+/* Set the active keymap
+   - input
+     kbd_keymap: PS2_KEYMAP_US or PS2_KEYMAP_D or PS2_KEYMAP_HU
+   - output
+     return: 0 = the keymap is not linked (see KEYMAP_... in ps2_codepage.h), 1 = ok */
+uint8_t ps2_kbd_setkeymap(uint8_t kbd_keymap)
+{
+  if((kbd_keymap >= sizeof(ps2_kbd_keymaps) / sizeof(ps2_kbd_keymaps[0])) || (ps2_kbd_keymaps[kbd_keymap] == NULL))
+    return 0;
+  ps2_kbd_keymap = ps2_kbd_keymaps[kbd_keymap];
+  return 1;
+}
+
+// ----------------------------------------------------------------------------
+/* Add hotkey (chord or key sequence)
+   - input
+     kbd_mods: event modifier bits (PS2_KMOD_..., all keys of the sequence with these modifiers)
+     kbd_keys: HID usage codes of the keys (1 key: chord, more keys: sequence, not modifier keys)
+     kbd_len: number of keys
+     kbd_id: hotkey id (PS2_KEV_HOTKEY event usage and ps2_kbd_cbhotkey parameter)
+   - output
+     return: 0 = no free node (KBD_HOTKEYS), wrong parameter or prefix conflict, 1 = ok
+   - note: a hotkey can not be the prefix of an other hotkey (e.g. Ctrl+K and Ctrl+K, Ctrl+C): return = 0,
+           the same sequence again: the hotkey id is changed */
+uint8_t ps2_kbd_addhotkey(uint8_t kbd_mods, const uint8_t * kbd_keys, uint8_t kbd_len, uint8_t kbd_id)
+{
+  #if KBD_HOTKEYS > 0
+  uint8_t i, n, pos = HK_NONE;
+  uint8_t * link;
+  uint32_t primask;
+
+  if((kbd_len == 0) || (kbd_keys == NULL))
+    return 0;
+  for(i = 0; i < kbd_len; i++)
+    if(kbd_keys[i] >= PS2_HID_LCTRL)
+      return 0;
+
+  primask = __get_PRIMASK();
+  __disable_irq();                      /* the decoder can run in the keyboard RX interrupt */
+  for(i = 0; i < kbd_len; i++)
+  { /* the already registered part of the sequence */
+    for(n = (pos == HK_NONE) ? ps2_kbd_hkroot : ps2_kbd_hknodes[pos].child; n != HK_NONE; n = ps2_kbd_hknodes[n].sibling)
+      if((ps2_kbd_hknodes[n].usage == kbd_keys[i]) && (ps2_kbd_hknodes[n].mods == kbd_mods))
+        break;
+    if(n == HK_NONE)
+      break;
+    if((ps2_kbd_hknodes[n].child == HK_NONE) != (i == kbd_len - 1))
+    { /* an other hotkey is the prefix of this or this is the prefix of an other hotkey */
+      __set_PRIMASK(primask);
+      return 0;
+    }
+    pos = n;
+  }
+  if(ps2_kbd_hkcnt + (kbd_len - i) > KBD_HOTKEYS)
+  { /* not enough free node (nothing is changed) */
+    __set_PRIMASK(primask);
+    return 0;
+  }
+  for(; i < kbd_len; i++)
+  { /* new nodes */
+    link = (pos == HK_NONE) ? &ps2_kbd_hkroot : &ps2_kbd_hknodes[pos].child;
+    n = ps2_kbd_hkcnt++;
+    ps2_kbd_hknodes[n].usage = kbd_keys[i];
+    ps2_kbd_hknodes[n].mods = kbd_mods;
+    ps2_kbd_hknodes[n].child = HK_NONE;
+    ps2_kbd_hknodes[n].sibling = *link;
+    *link = n;
+    pos = n;
+  }
+  ps2_kbd_hknodes[pos].id = kbd_id;
+  ps2_kbd_hkfirst[kbd_keys[0] >> 5] |= 1UL << (kbd_keys[0] & 0x1F);
+  __set_PRIMASK(primask);
+  return 1;
+  #else
+  return 0;
+  #endif
+}
+
+// ----------------------------------------------------------------------------
+/* Delete all hotkeys */
+void ps2_kbd_delhotkeys(void)
+{
+  #if KBD_HOTKEYS > 0
+  uint32_t i;
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  ps2_kbd_hkcnt = 0;
+  ps2_kbd_hkroot = HK_NONE;
+  ps2_kbd_hkpos = HK_NONE;
+  for(i = 0; i < 8; i++)
+    ps2_kbd_hkfirst[i] = 0;
+  __set_PRIMASK(primask);
+  #endif
 }
 
 // ----------------------------------------------------------------------------
-uint8_t ps2_kbd_ledstatus(void)
+/* Get the lock status (ST_KBDSCRLOCK, ST_KBDNUMLOCK, ST_KBDCAPSLOCK) */
+uint8_t ps2_kbd_lockstatus(void)
 {
   return ps2_kbdlockstatus;
 }
 
 // ----------------------------------------------------------------------------
-uint8_t ps2_kbd_ctrlstatus(void)
+/* Get the modifier buttons status (ST_KBDLCTRL ... ST_KBDRGUI, all 8 modifiers)
+   - note: it is updated when the scan codes are decoded (ps2_kbd_getevent, ps2_kbd_getkey or KBD_RXDECODE == 1: interrupt) */
+uint8_t ps2_kbd_ctrlstatus(void)
+{
+  return PS2_KBD_HIDMODS;
+}
+
+// ----------------------------------------------------------------------------
+/* Set the lock status (not blocking, the LEDs are updated in the background)
+   - input
+     kbd_locks: ST_KBDSCRLOCK, ST_KBDNUMLOCK, ST_KBDCAPSLOCK
+   - output
+     return: 1 = ok */
+uint8_t ps2_kbd_setlocks(uint8_t kbd_locks)
+{
+  uint32_t primask;
+  ps2_initcheck();
+  primask = __get_PRIMASK();
+  __disable_irq();
+  ps2_kbdlockstatus = kbd_locks & 0x07;
+  ps2_kbd_cmdnext();
+  __set_PRIMASK(primask);
+  ps2_kbd_cbstatus(PS2_KBD_HIDMODS, ps2_kbdlockstatus);
+  return 1;
+}
+
+// ----------------------------------------------------------------------------
+/* Get the LED update status
+   - output
+     return: 0 = the LEDs are not updated yet, 1 = the keyboard LEDs = lock status */
+uint8_t ps2_kbd_ledsynced(void)
+{
+  ps2_kbd_cmdpoll();
+  return (ps2_kbd_ledapplied == ps2_kbdlockstatus) && !ps2_kbd_lederror;
+}
+
+// ----------------------------------------------------------------------------
+/* Get the keyboard connection status
+   - output
+     return: 0 = the keyboard is disconnected, 1 = connected */
+uint8_t ps2_kbd_connected(void)
+{
+  #if KBD_HOTPLUG == 1
+  ps2_initcheck();
+  ps2_kbd_cmdpoll();
+  return ps2_kbd_connstatus;
+  #else
+  return 1;
+  #endif
+}
+
+// ----------------------------------------------------------------------------
+/* Set the keyboard typematic rate and delay (F3 command)
+   - input
+     kbd_typematic: PS2_TYPEMATIC_DELAY_xxx | rate (0x00 = 30 characters/sec ... 0x1F = 2 characters/sec)
+   - output
+     return: 1 = ok
+   - note: not blocking, the command is sent in the background
+           KBD_SWREPEAT == 1: the keyboard repeats are dropped, see ps2_kbd_setswrepeat */
+uint8_t ps2_kbd_settypematic(uint8_t kbd_typematic)
+{
+  uint32_t primask;
+  ps2_initcheck();
+  primask = __get_PRIMASK();
+  __disable_irq();
+  ps2_kbd_typwant = kbd_typematic & 0x7F;
+  ps2_kbd_cmdnext();
+  __set_PRIMASK(primask);
+  return 1;
+}
+
+// ----------------------------------------------------------------------------
+/* Set the scan code set
+   - input
+     kbd_set: 2 or 3 (set 3: the character keys make only, the modifiers make/break)
+   - output
+     return: 0 = set 3 is not linked (KBD_SCANSET3 == 0) or the previous setting is not finished, 1 = started
+   - note: if the keyboard does not know set 3 -> set 2 (see ps2_kbd_getscanset) */
+uint8_t ps2_kbd_setscanset(uint8_t kbd_set)
+{
+  #if KBD_SCANSET3 >= 1
+  uint32_t primask;
+  ps2_initcheck();
+  primask = __get_PRIMASK();
+  __disable_irq();
+  if(ps2_kbd_cmdstate && ((ps2_kbd_cmd == ps2_kbd_set3cmd) || (ps2_kbd_cmd == ps2_kbd_set3cfg) || (ps2_kbd_cmd == ps2_kbd_set2cmd)))
+  {
+    __set_PRIMASK(primask);
+    return 0;
+  }
+  ps2_kbd_setwant = (kbd_set == 3) ? 3 : 2;
+  ps2_kbd_typapplied = KCMD_UNKNOWN;    /* the typematic again after the set change */
+  ps2_kbd_cmdnext();
+  __set_PRIMASK(primask);
+  return 1;
+  #else
+  return 0;
+  #endif
+}
+
+// ----------------------------------------------------------------------------
+/* Get the active scan code set
+   - output
+     return: 0 = the setting is in progress, 2 or 3 = scan code set */
+uint8_t ps2_kbd_getscanset(void)
 {
-  return ps2_kbdctrlstatus;
+  #if KBD_SCANSET3 >= 1
+  ps2_kbd_cmdpoll();
+  if(ps2_kbd_setwant != ps2_kbd_scanset)
+    return 0;
+  if(ps2_kbd_cmdstate && ((ps2_kbd_cmd == ps2_kbd_set3cmd) || (ps2_kbd_cmd == ps2_kbd_set2cmd)))
+    return 0;
+  #endif
+  return ps2_kbd_scanset;
 }
 
 // ----------------------------------------------------------------------------
-uint8_t ps2_kbd_setlocks(uint8_t kbd_locks)
+/* Set the software repeat delay and period
+   - input
+     kbd_delay: first repeat delay (ms)
+     kbd_period: repeat period (ms, 0 = repeat off)
+   - output
+     return: 0 = no software repeat (KBD_SWREPEAT == 0), 1 = ok */
+uint8_t ps2_kbd_setswrepeat(uint16_t kbd_delay, uint16_t kbd_period)
 {
-  ps2_initcheck();
-  ps2_kbdlockstatus = kbd_locks & 0x07;
-  while(!ps2_kbd_datawrite(0xED));
-  while(!ps2_kbd_datawrite(ps2_kbdlockstatus));
+  #if KBD_SWREPEAT == 1
+  ps2_kbd_repdelay = kbd_delay;
+  ps2_kbd_repperiod = kbd_period;
   return 1;
+  #else
+  return 0;
+  #endif
 }
 
 #else
@@ -1002,7 +3071,29 @@ uint8_t ps2_kbd_setlocks(uint8_t kbd_locks)
 uint8_t ps2_kbd_getscan(uint8_t * kbd_scan)  {return 0;}
 uint8_t ps2_kbd_sendcmd(uint8_t kbd_command) {return 0;}
 uint8_t ps2_kbd_getkey(uint8_t * kbd_key)    {return 0;}
-uint8_t ps2_kbd_ledstatus(void)              {return 0;}
+uint32_t ps2_kbd_available(void)             {return 0;}
+uint8_t ps2_kbd_peek(uint32_t kbd_n)         {return 0;}
+uint8_t ps2_kbd_getevent(ps2_KbdEvent * kbd_event) {return 0;}
+uint8_t ps2_kbd_getchar32(uint32_t * kbd_char) {return 0;}
+uint8_t ps2_kbd_getutf8(uint8_t * kbd_utf8)  {return 0;}
+uint32_t ps2_kbd_getstring(uint8_t * kbd_str, uint32_t kbd_len) {return 0;}
+uint8_t ps2_kbd_getcard(ps2_KbdCard * kbd_card) {return 0;}
+void    ps2_kbd_lineinit(ps2_KbdLine * kbd_line, uint8_t * kbd_buf, uint32_t kbd_size) {kbd_line->size = 0;}
+uint8_t * ps2_kbd_getline(ps2_KbdLine * kbd_line, uint32_t * kbd_len) {return NULL;}
+uint8_t ps2_kbd_lockstatus(void)             {return 0;}
+uint8_t ps2_kbd_ctrlstatus(void)             {return 0;}
+uint8_t ps2_kbd_setlocks(uint8_t kbd_locks)  {return 0;}
+uint8_t ps2_kbd_ledsynced(void)              {return 0;}
+uint8_t ps2_kbd_connected(void)              {return 0;}
+uint8_t ps2_kbd_iskeydown(uint8_t kbd_usage) {return 0;}
+uint8_t ps2_kbd_setkeymap(uint8_t kbd_keymap) {return 0;}
+uint8_t ps2_kbd_settypematic(uint8_t kbd_typematic) {return 0;}
+uint8_t ps2_kbd_setscanset(uint8_t kbd_set)  {return 0;}
+uint8_t ps2_kbd_getscanset(void)             {return 0;}
+uint8_t ps2_kbd_addhotkey(uint8_t kbd_mods, const uint8_t * kbd_keys, uint8_t kbd_len, uint8_t kbd_id) {return 0;}
+void    ps2_kbd_delhotkeys(void)             { }
+uint8_t ps2_kbd_setswrepeat(uint16_t kbd_delay, uint16_t kbd_period) {return 0;}
+void    ps2_kbd_getkeydown(uint32_t * kbd_keys) {uint32_t i; for(i = 0; i < 8; i++) kbd_keys[i] = 0;}
 
 #endif
 
@@ -1013,408 +3104,369 @@ uint8_t ps2_kbd_ledstatus(void)              {return 0;}
 #if PS2_MOUSE_EXT_N >= 1
 
 uint32_t          time_data_packet;     /* packet start time */
-#if ((MOUSE_METHOD == 2) || (MOUSE_METHOD == 3))
 uint32_t          time_now;             /* now time */
+uint8_t           ps2_mouse_readreq = 0; /* 1 = the read data command is sent, the packet is not yet arrived */
+#if MOUSE_RXTIME == 1
+uint32_t          ps2_mouse_packettime; /* receive time of the last read packet (us) */
 #endif
 
-#define  MOUSE_UNINITIALIZATION   0     /* no connection the mouse or before reset */
-#define  MOUSE_RESET              1     /* reset  */
-#define  MOUSE_GETID              2     /* mouse ID */
-#define  MOUSE_SETRATE_200        3     /* set rate */
-#define  MOUSE_RATE_200           4     /* set rate */
-#define  MOUSE_SETRATE_100        5     /* set rate */
-#define  MOUSE_RATE_100           6     /* set rate */
-#define  MOUSE_SETRATE_80         7     /* set rate */
-#define  MOUSE_RATE_80            8     /* set rate */
-#define  MOUSE_GETMOVE            9     /* move data read */
-#define  MOUSE_ONDATAREPORT      10     /* mouse data report on */
-
-// ----------------------------------------------------------------------------
-/* read any bytes from mouse, timeout handled
-   - param1: pointer to data array
-   - param2: data array size,
-   - param3: timeout value (msec)
-   - return: 0 = timeout, 1 = no timeout but not arrived the pack, 2 = arrived the pack */
-uint8_t ps2_mouse_readdatapacket(uint8_t * data8, uint32_t dsize, uint32_t timeout)
-{
-  #if MOUSE_METHOD == 1
-
-  while(FIFO_LEN(mouserbuf) < dsize)
-  {
-    if(PS2_GETTIME() - time_data_packet > timeout)
-      return 0;
-  }
+// ----------------------------------------------------------------------------
+#if MOUSE_ACCEL == 1
+/* pointer acceleration and axis transform (fixed point, the fractions are carried to the next packet) */
+static const uint16_t ps2_mouse_accellut[] = {MOUSE_ACCEL_LUT};
 
-  while(dsize--)
-  {
-    ps2_mouse_dataread(data8);
-    data8++;
-  }
-  return 2;
+static void ps2_mouse_accel(ps2_MouseData * mouse_data)
+{
+  int32_t  x, y, speed;
+  uint32_t gain;
+
+  #if MOUSE_SWAPXY == 1
+  x = mouse_data->ymove;
+  y = mouse_data->xmove;
+  #else
+  x = mouse_data->xmove;
+  y = mouse_data->ymove;
+  #endif
+  #if MOUSE_INVERTX == 1
+  x = -x;
+  #endif
+  #if MOUSE_INVERTY == 1
+  y = -y;
+  #endif
 
-  #elif ((MOUSE_METHOD == 2) || (MOUSE_METHOD == 3))
-  uint8_t tmp8;
-  if(FIFO_LEN(mouserbuf) >= dsize)
-  {
-    ps2_printf("mrx: %d, %d\r\n", (unsigned int)time_now, (unsigned int)dsize);
-    while(dsize--)
+  speed = (x < 0) ? -x : x;
+  if(y > speed)
+    speed = y;
+  else if(-y > speed)
+    speed = -y;
+  speed /= MOUSE_ACCEL_STEP;
+  if((uint32_t)speed >= sizeof(ps2_mouse_accellut) / sizeof(ps2_mouse_accellut[0]))
+    speed = sizeof(ps2_mouse_accellut) / sizeof(ps2_mouse_accellut[0]) - 1;
+  gain = ps2_mouse_accellut[speed];
+
+  x = x * (int32_t)((gain * MOUSE_SCALEX) >> 8) + ps2_mouse_remx;
+  y = y * (int32_t)((gain * MOUSE_SCALEY) >> 8) + ps2_mouse_remy;
+  ps2_mouse_remx = x % 256;
+  ps2_mouse_remy = y % 256;
+  mouse_data->xmove = x / 256;
+  mouse_data->ymove = y / 256;
+}
+#endif
+
+// ----------------------------------------------------------------------------
+/* mouse packet -> move data
+   - packet[0]: Y overflow, X overflow, Y sign, X sign, 1, middle, right, left button
+   - packet[1], packet[2]: X, Y move
+   - packet[3] (ID 3 mouse): Z move
+   - packet[3] (ID 4 mouse): 0, 0, 5th button, 4th button, 4 bit Z move
+                             or 1, 0, 6 bit Z move / 0, 1, 6 bit horizontal wheel move */
+static void ps2_mouse_decode(const uint8_t * packet, ps2_MouseData * mouse_data)
+{
+  int16_t tmp16;
+
+  /* x move */
+  if(packet[0] & 0x40)
+    tmp16 = 256;
+  else
+    tmp16 = 0;
+  tmp16 += packet[1];
+  if(packet[0] & 0x10)
+    tmp16 -= 256;
+  mouse_data->xmove = tmp16;
+
+  /* y move */
+  if(packet[0] & 0x80)
+    tmp16 = 256;
+  else
+    tmp16 = 0;
+  tmp16 += packet[2];
+  if(packet[0] & 0x20)
+    tmp16 -= 256;
+  mouse_data->ymove = tmp16;
+
+  /* z move, horizontal wheel move and buttons */
+  mouse_data->zmove = 0;
+  mouse_data->wmove = 0;
+  mouse_data->btns = packet[0] & 0x07;
+  if(ps2_mouse_id == 0x03)
+    mouse_data->zmove = (int8_t)packet[3]; /* wheel mouse */
+  else if(ps2_mouse_id == 0x04)
+  { /* 5 button mouse */
+    if((packet[3] & 0xC0) == 0x80)
+      mouse_data->zmove = (int16_t)(packet[3] & 0x1F) - (int16_t)(packet[3] & 0x20);
+    else if((packet[3] & 0xC0) == 0x40)
+      mouse_data->wmove = (int16_t)(packet[3] & 0x1F) - (int16_t)(packet[3] & 0x20);
+    else
     {
-      ps2_mouse_dataread(data8);
-      data8++;
+      mouse_data->zmove = (int16_t)(packet[3] & 0x07) - (int16_t)(packet[3] & 0x08);
+      mouse_data->btns |= (packet[3] >> 1) & 0x18;
     }
-    return 2;
   }
-  else
+
+  #if MOUSE_ACCEL == 1
+  ps2_mouse_accel(mouse_data);
+  #endif
+}
+
+// ----------------------------------------------------------------------------
+/* packet check at the n. byte of the RX fifo (the packet is in the fifo)
+   - header bit 3 is always 1
+   - sign bit without overflow: the move byte is not 0 (-256 is not possible)
+   - wheel mouse (ID 3): Z move -8..7
+   - 5 button mouse (ID 4): 4th byte bit 7, 6 = 0, 0 (4 bit Z form) or 1, 0 / 0, 1 (6 bit forms), never 1, 1 */
+#define  MOUSE_PEEK(n)  ((uint8_t)mouserbuf.data[(mouserbuf.out + (n)) & (MOUSERBUF_SIZE - 1)])
+
+static uint8_t ps2_mouse_packetcheck(uint32_t n)
+{
+  uint8_t hdr = MOUSE_PEEK(n);
+  if(!(hdr & 0x08))
+    return 0;
+  if(((hdr & 0x50) == 0x10) && !MOUSE_PEEK(n + 1))
+    return 0;                           /* X sign without X overflow */
+  if(((hdr & 0xA0) == 0x20) && !MOUSE_PEEK(n + 2))
+    return 0;                           /* Y sign without Y overflow */
+  if(ps2_mouse_id == 0x03)
   {
-    if(time_now - time_data_packet > timeout)
-    { /* timeout */
-      ps2_printf("mrx_tout: %d, %d\r\n", (unsigned int)time_now, (unsigned int)dsize);
-      while(ps2_mouse_dataread(&tmp8)); /* receive buffer emptying */
+    hdr = MOUSE_PEEK(n + 3) & 0xF0;
+    if((hdr != 0x00) && (hdr != 0xF0))
       return 0;
-    }
-    else
-      return 1;
   }
-  #endif
+  else if(ps2_mouse_id == 0x04)
+  {
+    if((MOUSE_PEEK(n + 3) & 0xC0) == 0xC0)
+      return 0;
+  }
+  return 1;
 }
 
+#if MOUSE_RXTIME == 1
 // ----------------------------------------------------------------------------
-/* get mouse move */
-uint8_t ps2_mouse_getmove(ps2_MouseData * mouse_data)
+/* receive time of the next packet in the RX fifo
+   - one time stamp / packet: the last time stamps belong to the started packets in the fifo */
+static uint32_t ps2_mouse_rxtimeget(void)
 {
-  static uint8_t    mouse_status = MOUSE_UNINITIALIZATION;
-  int16_t           tmp16;
-  uint8_t           tmp8;
-
-  #if PS2_PIN_DEBUG == 2
-  GPIOX_SET(PS2_PIN_DEBUG_2);
-  #endif
-
-  ps2_initcheck();
-
-  /* if not initialize a mouse */
-
-  #if MOUSE_METHOD == 1
-  uint8_t           data_packet[5];
+  uint32_t primask, t;
+  primask = __get_PRIMASK();
+  __disable_irq();
+  t = mouserxtime[(mouserxtin - (FIFO_LEN(mouserbuf) + read_packet_size - 1) / read_packet_size) & (MOUSERXTIME_SIZE - 1)];
+  __set_PRIMASK(primask);
+  return t;
+}
+#endif
 
-  time_data_packet = PS2_GETTIME();
-  if(mouse_status == MOUSE_GETMOVE)
+// ----------------------------------------------------------------------------
+/* read one packet from the RX fifo with packet boundary resynchronization
+   - bad packet: the next byte is the packet start candidate
+   - after a bad packet the next packet is checked also (if it is in the fifo)
+   - after the dropped bytes the packet phase of the RX interrupt follows the new packet boundary
+   - return: 0 = no complete packet, 1 = packet ok */
+static uint8_t ps2_mouse_readpacket(uint8_t * packet)
+{
+  static uint8_t resync = 0;
+  uint32_t i, primask;
+  uint8_t dropped = 0;
+  while(FIFO_LEN(mouserbuf) >= read_packet_size)
   {
-    ps2_mouse_datawrite(0xEB);            /* send the read data command */
-    tmp8 = ps2_mouse_readdatapacket(data_packet, read_packet_size, PS2_MOUSE_READTIME);
-    if(tmp8 == 2)
-    { /* complett pack size */
-      if(data_packet[0] != 0xFA)
+    if(ps2_mouse_packetcheck(0))
+    {
+      if(!resync)
+        break;
+      if(FIFO_LEN(mouserbuf) < 2 * read_packet_size)
+        break;
+      if(ps2_mouse_packetcheck(read_packet_size))
       {
-        #if PS2_PIN_DEBUG == 2
-        GPIOX_CLR(PS2_PIN_DEBUG_2);
-        #endif
-        return 0;
-      }
-
-      /* x move */
-      if(data_packet[1] & 0x40)
-        tmp16 = 256;
-      else
-        tmp16 = 0;
-      tmp16 += data_packet[2];
-      if(data_packet[1] & 0x10)
-        tmp16 -= 256;
-      mouse_data->xmove = tmp16;
-
-      /* y move */
-      if(data_packet[1] & 0x80)
-        tmp16 = 256;
-      else
-        tmp16 = 0;
-      tmp16 += data_packet[3];
-      if(data_packet[1] & 0x20)
-        tmp16 -= 256;
-      mouse_data->ymove = tmp16;
-
-      /* z move and buttons */
-      if(read_packet_size == 4)
-      { /* 3 byte mouse data size */
-        mouse_data->zmove = 0;
-        mouse_data->btns = data_packet[1] & 0x07;
-      }
-      else
-      { /* 4 byte mouse data size */
-        mouse_data->zmove = (int8_t)data_packet[4];
-        mouse_data->btns = data_packet[1] & 0x07;
+        resync = 0;
+        break;
       }
-
-      #if PS2_PIN_DEBUG == 2
-      GPIOX_CLR(PS2_PIN_DEBUG_2);
-      #endif
-      return 1;
-    }
-    else if(tmp8 == 0)
-    {
-      mouse_status = MOUSE_UNINITIALIZATION;
     }
+    mouserbuf.out++;                    /* not a packet start: drop one byte */
+    resync = 1;
+    dropped = 1;
+    ps2_printf("mouse resync\r\n");
   }
-
-  else if(mouse_status == MOUSE_GETID)
+  if(dropped)
   {
-    ps2_mouse_datawrite(0xF2);      /* mouse ID */
-    tmp8 = ps2_mouse_readdatapacket(data_packet, 2, PS2_MOUSE_IDTIME);
-    if((tmp8 == 2) && (data_packet[0] == 0xFA) && ((data_packet[1] == 0x00) || (data_packet[1] == 0x03)))
-    {
-      mouse_status = MOUSE_GETMOVE;
-      if(data_packet[1] == 0x00)
-        read_packet_size = 4;
-      else if(data_packet[1] == 0x03)
-        read_packet_size = 5;
-    }
+    primask = __get_PRIMASK();
+    __disable_irq();
+    if(!ps2_mouse_rxbad)
+      ps2_mouse_rxphase = FIFO_LEN(mouserbuf) % read_packet_size;
+    __set_PRIMASK(primask);
   }
+  if(FIFO_LEN(mouserbuf) < read_packet_size)
+    return 0;
+  #if MOUSE_RXTIME == 1
+  ps2_mouse_packettime = ps2_mouse_rxtimeget();
+  #endif
+  for(i = 0; i < read_packet_size; i++)
+    ps2_mouse_dataread(&packet[i]);
+  return 1;
+}
 
-  else if((mouse_status >= MOUSE_SETRATE_200) && (mouse_status <= MOUSE_RATE_80))
-  {
-    if(mouse_status == MOUSE_RATE_200)
-      ps2_mouse_datawrite(0xC8);        /* 200 */
-    else if(mouse_status == MOUSE_RATE_100)
-      ps2_mouse_datawrite(0x64);        /* 100 */
-    else if(mouse_status == MOUSE_RATE_80)
-      ps2_mouse_datawrite(0x50);        /* 80 */
-    else
-      ps2_mouse_datawrite(0xF3);        /* set sample rate */
-    tmp8 = ps2_mouse_readdatapacket(data_packet, 1, PS2_MOUSE_RATETIME);
-    if((tmp8 == 2) && (data_packet[0] == 0xFA))
+// ----------------------------------------------------------------------------
+/* saturating add (a + b) */
+static inline int32_t ps2_mouse_satadd(int32_t a, int32_t b)
+{
+  if((b > 0) && (a > INT32_MAX - b))
+    return INT32_MAX;
+  if((b < 0) && (a < INT32_MIN - b))
+    return INT32_MIN;
+  return a + b;
+}
+
+// ----------------------------------------------------------------------------
+/* int32 -> int16 with saturation */
+static inline int16_t ps2_mouse_sat16(int32_t a)
+{
+  if(a > INT16_MAX)
+    return INT16_MAX;
+  if(a < INT16_MIN)
+    return INT16_MIN;
+  return a;
+}
+
+// ----------------------------------------------------------------------------
+/* mouse command timeout, init, method change (return: 1 = the mouse is ready) */
+static uint8_t ps2_mouse_poll(void)
+{
+  uint32_t          primask;
+
+  ps2_initcheck();
+
+  time_now = PS2_GETTIME();
+  primask = __get_PRIMASK();
+  __disable_irq();
+  ps2_mouse_cmdpoll();                  /* command timeout, init */
+  if(ps2_mouse_status != MOUSE_READY)
+    ps2_mouse_readreq = 0;              /* the read data command is lost (init) */
+  else if(!ps2_mouse_cmdstate &&
+          (ps2_mouse_mode != ((ps2_mouse_method == 3) ? MOUSE_MODE_STREAM : MOUSE_MODE_REMOTE)))
+  { /* the method is changed: stream <-> remote mode (after the packet of the read data command) */
+    if(!ps2_mouse_readreq || (FIFO_LEN(mouserbuf) >= read_packet_size) || (time_now - time_data_packet > PS2_MOUSE_READTIME))
     {
-      if(mouse_status == MOUSE_RATE_80)
-        mouse_status = MOUSE_GETID;
-      else
-        mouse_status++;
+      ps2_mouse_readreq = 0;
+      ps2_mouse_setmode();
     }
-    else
-      mouse_status = MOUSE_UNINITIALIZATION;
   }
+  __set_PRIMASK(primask);
+  return ps2_mouse_status == MOUSE_READY;
+}
 
-  else if(mouse_status == MOUSE_UNINITIALIZATION)
-  {
-    while(ps2_mouse_dataread(&tmp8));   /* receive buffer empty */
-    ps2_mouse_datawrite(0xFF);          /* mouse reset */
-    tmp8 = ps2_mouse_readdatapacket(data_packet, 3, PS2_MOUSE_RESETTIME);
-    if((tmp8 == 2) && (data_packet[0] == 0xFA) && (data_packet[1] == 0xAA) && (data_packet[2] == 0x00))
-      mouse_status = MOUSE_SETRATE_200;
-  }
+// ----------------------------------------------------------------------------
+/* get mouse move
+   - the mouse init runs in the background (ps2_mouse_getmove returns 0 until the mouse is ready)
+   - method 1: read data command, ps2_mouse_getmove returns 0 until its packet arrives (max. PS2_MOUSE_READTIME),
+     the next read data command at the next call (fresh data)
+   - method 2: the packet of the previous read data command and the next read data command immediately
+   - method 3: the packets of the stream mode, summarized until the button change */
+uint8_t ps2_mouse_getmove(ps2_MouseData * mouse_data)
+{
+  uint32_t          primask;
+  uint8_t           data_packet[4];
 
   #if PS2_PIN_DEBUG == 2
-  GPIOX_CLR(PS2_PIN_DEBUG_2);
+  GPIOX_SET(PS2_PIN_DEBUG_2);
   #endif
-  return 0;
 
-  #elif MOUSE_METHOD == 2
+  if(!ps2_mouse_poll())
+  {
+    #if PS2_PIN_DEBUG == 2
+    GPIOX_CLR(PS2_PIN_DEBUG_2);
+    #endif
+    return 0;
+  }
 
-  uint8_t           data_packet[5];
+  if(ps2_mouse_method != 3)
+  { /* method 1, 2: remote mode */
+    if(!ps2_mouse_readreq)
+    { /* read data command */
+      primask = __get_PRIMASK();
+      __disable_irq();
+      ps2_mouse_cmdstart(ps2_mouse_readcmd);
+      __set_PRIMASK(primask);
+      time_data_packet = PS2_GETTIME();
+      ps2_mouse_readreq = 1;
+    }
 
-  time_now = PS2_GETTIME();
-  if(mouse_status == MOUSE_GETMOVE)
-  {
-    tmp8 = ps2_mouse_readdatapacket(data_packet, read_packet_size, PS2_MOUSE_READTIME);
-    if(tmp8 == 2)
+    if(ps2_mouse_readpacket(data_packet))
     { /* complett pack size */
-      if(data_packet[0] != 0xFA)
-      {
-        #if PS2_PIN_DEBUG == 2
-        GPIOX_CLR(PS2_PIN_DEBUG_2);
-        #endif
-        return 0;
-      }
-
-      /* x move */
-      if(data_packet[1] & 0x40)
-        tmp16 = 256;
-      else
-        tmp16 = 0;
-      tmp16 += data_packet[2];
-      if(data_packet[1] & 0x10)
-        tmp16 -= 256;
-      mouse_data->xmove = tmp16;
-
-      /* y move */
-      if(data_packet[1] & 0x80)
-        tmp16 = 256;
-      else
-        tmp16 = 0;
-      tmp16 += data_packet[3];
-      if(data_packet[1] & 0x20)
-        tmp16 -= 256;
-      mouse_data->ymove = tmp16;
-
-      /* z move and buttons */
-      if(read_packet_size == 4)
-      { /* 3 byte mouse data size */
-        mouse_data->zmove = 0;
-        mouse_data->btns = data_packet[1] & 0x07;
-      }
-      else
-      { /* 4 byte mouse data size */
-        mouse_data->zmove = (int8_t)data_packet[4];
-        mouse_data->btns = data_packet[1] & 0x07;
+      ps2_mouse_decode(data_packet, mouse_data);
+      ps2_mouse_readreq = 0;
+      if(ps2_mouse_method == 2)
+      { /* the next read data command */
+        primask = __get_PRIMASK();
+        __disable_irq();
+        ps2_mouse_cmdstart(ps2_mouse_readcmd);
+        __set_PRIMASK(primask);
+        time_data_packet = PS2_GETTIME();
+        ps2_mouse_readreq = 1;
       }
-      ps2_mouse_datawrite(0xEB);        /* send the read data command */
-      time_data_packet = time_now;
       #if PS2_PIN_DEBUG == 2
       GPIOX_CLR(PS2_PIN_DEBUG_2);
       #endif
       return 1;
     }
-    else if(tmp8 == 0)
-    {
-      mouse_status = MOUSE_UNINITIALIZATION;
-    }
-  }
-
-  else if(mouse_status == MOUSE_GETID)
-  {
-    tmp8 = ps2_mouse_readdatapacket(data_packet, 2, PS2_MOUSE_IDTIME);
-    if((tmp8 == 2) && (data_packet[0] == 0xFA) && ((data_packet[1] == 0x00) || (data_packet[1] == 0x03)))
-    { /* FA 00 or FA 03 */
-      ps2_mouse_datawrite(0xEB);            /* send the read data command */
-      time_data_packet = time_now;
-      mouse_status = MOUSE_GETMOVE;
-      if(data_packet[1] == 0x00)
-        read_packet_size = 4;
-      else if(data_packet[1] == 0x03)
-        read_packet_size = 5;
-    }
-    else if(tmp8 == 0)
-      mouse_status = MOUSE_UNINITIALIZATION;
-  }
-
-  else if((mouse_status >= MOUSE_SETRATE_200) && (mouse_status <= MOUSE_RATE_80))
-  {
-    tmp8 = ps2_mouse_readdatapacket(data_packet, 1, PS2_MOUSE_RATETIME);
-    if((tmp8 == 2) && (data_packet[0] == 0xFA))
-    {
-      if(mouse_status < MOUSE_RATE_80)
-      {
-        mouse_status++;
-        if(mouse_status == MOUSE_RATE_200)
-          ps2_mouse_datawrite(0xC8);    /* 200 */
-        else if(mouse_status == MOUSE_RATE_100)
-          ps2_mouse_datawrite(0x64);    /* 100 */
-        else if(mouse_status == MOUSE_RATE_80)
-          ps2_mouse_datawrite(0x50);    /* 80 */
-        else
-          ps2_mouse_datawrite(0xF3);    /* set sample rate */
-      }
-      else
-      {
-        ps2_mouse_datawrite(0xF2);      /* mouse ID */
-        mouse_status = MOUSE_GETID;
-      }
-      time_data_packet = time_now;
-    }
-    else if(tmp8 == 0)
-      mouse_status = MOUSE_UNINITIALIZATION;
-  }
-
-  else if(mouse_status == MOUSE_RESET)
-  {
-    tmp8 = ps2_mouse_readdatapacket(data_packet, 3, PS2_MOUSE_RESETTIME);
-    if(tmp8 == 2)
-    {
-      if((data_packet[0] == 0xFA) && (data_packet[1] == 0xAA) && (data_packet[2] == 0x00))
-      {
-        ps2_mouse_datawrite(0xF3);      /* set sample rate */
-        time_data_packet = time_now;
-        mouse_status = MOUSE_SETRATE_200;
-      }
-    }
-    else if(tmp8 == 0)
-    {
-      mouse_status = MOUSE_UNINITIALIZATION;
+    else if(PS2_GETTIME() - time_data_packet > PS2_MOUSE_READTIME)
+    { /* no packet: init again */
+      ps2_mouse_readreq = 0;
+      ps2_mouse_status = MOUSE_UNINITIALIZATION;
     }
   }
+  else
+  { /* method 3: stream mode */
+    static uint8_t    pre_mouse_buttons;
+    static uint32_t   pre_fifo_len = 0;
+    uint32_t          fifo_len;
+    ps2_MouseData     md;
+    uint8_t           tmp8;
+    int32_t           zsum, wsum;
+    #if MOUSE_SUM_PACKETS > 0
+    uint32_t          packets = 0;
+    #endif
+    #if MOUSE_SUM_AGE > 0
+    uint32_t          first_time;
+    #endif
 
-  else if(mouse_status == MOUSE_UNINITIALIZATION)
-  {
-    while(ps2_mouse_dataread(&tmp8));   /* receive buffer empty */
-    ps2_mouse_datawrite(0xFF);          /* mouse reset */
-    time_data_packet = time_now;
-    mouse_status = MOUSE_RESET;
-    ps2_printf("mouse reset\r\n");
-  }
-  #if PS2_PIN_DEBUG == 2
-  GPIOX_CLR(PS2_PIN_DEBUG_2);
-  #endif
-  return 0;
-
-  #elif MOUSE_METHOD == 3
-
-  static uint8_t    pre_mouse_buttons, id;
-  uint32_t          fifo_len;
-  uint8_t           data_packet[4];
-
-  #if PS2_PRINTF_DEBUG == 1
-  static uint32_t   n = 0;
-  n++;
-  #endif
-
-  time_now = PS2_GETTIME();
-
-  if(mouse_rx_error)
-  {
-    mouse_status = MOUSE_UNINITIALIZATION;
-    mouse_rx_error = 0;
-    ps2_printf("mrx_parityerr: %d, %d\r\n", (unsigned int)time_now, (unsigned int)n);
-  }
-
-  if(mouse_status == MOUSE_GETMOVE)
-  {
-    fifo_len = FIFO_LEN(mouserbuf);
-    if(fifo_len >= read_packet_size)
+    if(ps2_mouse_readpacket(data_packet))
     { /* completed pack size */
       mouse_data->xmove = 0;
       mouse_data->ymove = 0;
-      mouse_data->zmove = 0;
       mouse_data->btns  = 0;
+      zsum = 0;
+      wsum = 0;
+      #if MOUSE_SUM_AGE > 0
+      first_time = ps2_mouse_packettime;
+      #endif
       while(1)
       {
-        ps2_mouse_dataread(&data_packet[0]);
-        ps2_mouse_dataread(&data_packet[1]);
-        ps2_mouse_dataread(&data_packet[2]);
-
-        /* x move */
-        if(data_packet[0] & 0x40)
-          tmp16 = 256;
-        else
-          tmp16 = 0;
-        tmp16 += data_packet[1];
-        if(data_packet[0] & 0x10)
-          tmp16 -= 256;
-        mouse_data->xmove += tmp16;
-
-        /* y move */
-        if(data_packet[0] & 0x80)
-          tmp16 = 256;
-        else
-          tmp16 = 0;
-        tmp16 += data_packet[2];
-        if(data_packet[0] & 0x20)
-          tmp16 -= 256;
-        mouse_data->ymove += tmp16;
-
-        /* z move and buttons */
-        if(read_packet_size == 3)
-        { /* 3 byte mouse data size */
-          mouse_data->zmove = 0;
-          mouse_data->btns = data_packet[0] & 0x07;
-        }
-        else
-        { /* 4 byte mouse data size */
-          ps2_mouse_dataread(&data_packet[3]);
-          mouse_data->zmove += (int8_t)data_packet[3];
-          mouse_data->btns = data_packet[0] & 0x07;
-        }
-
-        if((FIFO_LEN(mouserbuf) < read_packet_size) || mouse_data->btns != pre_mouse_buttons)
+        ps2_mouse_decode(data_packet, &md);
+        mouse_data->xmove = ps2_mouse_satadd(mouse_data->xmove, md.xmove);
+        mouse_data->ymove = ps2_mouse_satadd(mouse_data->ymove, md.ymove);
+        zsum = ps2_mouse_satadd(zsum, md.zmove);
+        wsum = ps2_mouse_satadd(wsum, md.wmove);
+        mouse_data->btns = md.btns;
+
+        if((mouse_data->btns != pre_mouse_buttons)
+           #if MOUSE_SUM_PACKETS > 0
+           || (++packets >= MOUSE_SUM_PACKETS)
+           #endif
+           #if MOUSE_SUM_DELTA > 0
+           || (mouse_data->xmove >= MOUSE_SUM_DELTA) || (mouse_data->xmove <= -MOUSE_SUM_DELTA)
+           || (mouse_data->ymove >= MOUSE_SUM_DELTA) || (mouse_data->ymove <= -MOUSE_SUM_DELTA)
+           #endif
+           #if MOUSE_SUM_WHEELBREAK == 1
+           || md.zmove || md.wmove
+           #endif
+           #if MOUSE_SUM_AGE > 0
+           || ((FIFO_LEN(mouserbuf) >= read_packet_size) &&
+               (ps2_mouse_rxtimeget() - first_time > MOUSE_SUM_AGE * 1000))
+           #endif
+           || !ps2_mouse_readpacket(data_packet))
         {
+          mouse_data->zmove = ps2_mouse_sat16(zsum);
+          mouse_data->wmove = ps2_mouse_sat16(wsum);
           pre_mouse_buttons = mouse_data->btns;
           time_data_packet = time_now;
+          pre_fifo_len = FIFO_LEN(mouserbuf);
           #if PS2_PIN_DEBUG == 2
           GPIOX_CLR(PS2_PIN_DEBUG_2);
           #endif
@@ -1422,131 +3474,71 @@ uint8_t ps2_mouse_getmove(ps2_MouseData * mouse_data)
         }
       }
     }
-    else if(fifo_len <= 1)
-    {
-      time_data_packet = time_now;
-    }
-    else
-    {
-      if(time_now - time_data_packet > PS2_MOUSE_READTIME)
-        while(ps2_mouse_dataread(&tmp8)); /* if big time space -> receive buffer empty (sync repair) */
-    }
-  }
 
-  else if(mouse_status == MOUSE_ONDATAREPORT)
-  {
-    tmp8 = ps2_mouse_readdatapacket((uint8_t *)&data_packet, 1, PS2_MOUSE_IDTIME);
-    if((tmp8 == 2) && (data_packet[0] == 0xFA))
+    fifo_len = FIFO_LEN(mouserbuf);
+    if((fifo_len == 0) || (fifo_len != pre_fifo_len))
     {
       time_data_packet = time_now;
-      mouse_status = MOUSE_GETMOVE;
-      read_packet_size = id;
+      pre_fifo_len = fifo_len;
     }
-    else if(tmp8 == 0)
-      mouse_status = MOUSE_UNINITIALIZATION;
-  }
-
-  else if(mouse_status == MOUSE_GETID)
-  {
-    tmp8 = ps2_mouse_readdatapacket((uint8_t *)&data_packet, 2, PS2_MOUSE_IDTIME);
-    if((tmp8 == 2) && (data_packet[0] == 0xFA) && ((data_packet[1] == 0x00) || (data_packet[1] == 0x03)))
-    { /* FA 00 or FA 03 */
-      ps2_mouse_datawrite(0xF4);            /* enable data reporting */
-      ps2_printf("mtx:0xF4, %d, %d\r\n", (unsigned int)time_now, (unsigned int)n);
-      time_data_packet = time_now;
-      mouse_status = MOUSE_ONDATAREPORT;
-      if(data_packet[1] == 0x00)
-        id = 3;
-      else if(data_packet[1] == 0x03)
-        id = 4;
-      read_packet_size = 1;
+    else if(time_now - time_data_packet > PS2_MOUSE_READTIME)
+    { /* incomplete packet without new byte: drop it */
+      while(ps2_mouse_dataread(&tmp8));
+      pre_fifo_len = 0;
     }
-    else if(tmp8 == 0)
-      mouse_status = MOUSE_UNINITIALIZATION;
   }
 
-  else if((mouse_status >= MOUSE_SETRATE_200) && (mouse_status <= MOUSE_RATE_80))
-  {
-    tmp8 = ps2_mouse_readdatapacket((uint8_t *)&data_packet, 1, PS2_MOUSE_RATETIME);
-    if((tmp8 == 2) && (data_packet[0] == 0xFA))
-    {
-      if(mouse_status < MOUSE_RATE_80)
-      {
-        mouse_status++;
-        if(mouse_status == MOUSE_RATE_200)
-        {
-          ps2_mouse_datawrite(0xC8);    /* 200 */
-          ps2_printf("mtx:0xC8, %d, %d\r\n", (unsigned int)time_now, (unsigned int)n);
-        }
-        else if(mouse_status == MOUSE_RATE_100)
-        {
-          ps2_mouse_datawrite(0x64);    /* 100 */
-          ps2_printf("mtx:0x64, %d, %d\r\n", (unsigned int)time_now, (unsigned int)n);
-        }
-        else if(mouse_status == MOUSE_RATE_80)
-        {
-          ps2_mouse_datawrite(0x50);    /* 80 */
-          ps2_printf("mtx:0x50, %d, %d\r\n", (unsigned int)time_now, (unsigned int)n);
+  #if PS2_PIN_DEBUG == 2
+  GPIOX_CLR(PS2_PIN_DEBUG_2);
+  #endif
+  return 0;
+}
 
-        }
-        else
-        {
-          ps2_mouse_datawrite(0xF3);    /* set sample rate */
-          ps2_printf("mtx:0xF3, %d, %d\r\n", (unsigned int)time_now, (unsigned int)n);
-        }
-      }
-      else
-      {
-        ps2_mouse_datawrite(0xF2);      /* mouse ID */
-        ps2_printf("mtx:0xF2, %d, %d\r\n", (unsigned int)time_now, (unsigned int)n);
-        mouse_status = MOUSE_GETID;
-        read_packet_size = 2;
-      }
-      time_data_packet = time_now;
-    }
-    else if(tmp8 == 0)
-      mouse_status = MOUSE_UNINITIALIZATION;
-  }
+// ----------------------------------------------------------------------------
+#if MOUSE_EVENTS == 1
+/* get mouse events (method 3: every stream packet is one event with time stamp)
+   - return: the number of the events */
+uint32_t ps2_mouse_getevents(ps2_MouseEvent * mouse_events, uint32_t mouse_maxnum)
+{
+  uint32_t          n = 0;
+  uint8_t           data_packet[4];
+  ps2_MouseData     md;
 
-  else if(mouse_status == MOUSE_RESET)
-  {
-    tmp8 = ps2_mouse_readdatapacket((uint8_t *)&data_packet, 3, PS2_MOUSE_RESETTIME);
-    if(tmp8 == 2)
-    {
-      if((data_packet[0] == 0xFA) && (data_packet[1] == 0xAA) && (data_packet[2] == 0x00))
-      {
-        ps2_mouse_datawrite(0xF3);      /* set sample rate */
-        ps2_printf("mtx:0xF3, %d, %d\r\n", (unsigned int)time_now, (unsigned int)n);
-        time_data_packet = time_now;
-        mouse_status = MOUSE_SETRATE_200;
-        read_packet_size = 1;
-      }
-    }
-    else if(tmp8 == 0)
-    {
-      mouse_status = MOUSE_UNINITIALIZATION;
-    }
-  }
+  if(!ps2_mouse_poll() || (ps2_mouse_method != 3))
+    return 0;
 
-  else if(mouse_status == MOUSE_UNINITIALIZATION)
+  while((n < mouse_maxnum) && ps2_mouse_readpacket(data_packet))
   {
-    while(ps2_mouse_dataread(&tmp8));   /* receive buffer empty */
-    ps2_mouse_datawrite(0xFF);          /* mouse reset */
-    time_data_packet = time_now;
-    mouse_status = MOUSE_RESET;
-    ps2_printf("mtx:0xFF, %d, %d\r\n", (unsigned int)time_now, (unsigned int)n);
-    read_packet_size = 1;
+    ps2_mouse_decode(data_packet, &md);
+    mouse_events[n].t_us = ps2_mouse_packettime;
+    mouse_events[n].dx = md.xmove;
+    mouse_events[n].dy = md.ymove;
+    mouse_events[n].dz = md.zmove;
+    mouse_events[n].dw = md.wmove;
+    mouse_events[n].btns = md.btns;
+    n++;
   }
-  #if PS2_PIN_DEBUG == 2
-  GPIOX_CLR(PS2_PIN_DEBUG_2);
-  #endif
-  return 0;
+  return n;
+}
+#else
+uint32_t ps2_mouse_getevents(ps2_MouseEvent * mouse_events, uint32_t mouse_maxnum) {return 0;}
+#endif
 
-  #endif
+// ----------------------------------------------------------------------------
+/* get move method change (1, 2, 3) without mouse reset
+   - the stream / remote mode is changed from ps2_mouse_getmove */
+uint8_t ps2_mouse_setmethod(uint8_t mouse_method)
+{
+  if((mouse_method < 1) || (mouse_method > 3))
+    return 0;
+  ps2_mouse_method = mouse_method;
+  return 1;
 }
 
 #else
 
 uint8_t ps2_mouse_getmove(ps2_MouseData * mouse_data) {return 0;}
+uint8_t ps2_mouse_setmethod(uint8_t mouse_method) {return 0;}
+uint32_t ps2_mouse_getevents(ps2_MouseEvent * mouse_events, uint32_t mouse_maxnum) {return 0;}
 
 #endif
@@ -16,11 +16,60 @@ extern "C" {
        note: if return = 0 -> there was no keyboard event
              if return = 1 -> &kbd_key = asc code
 
+   - uint32_t ps2_kbd_available(void) : number of the decoded characters ready for ps2_kbd_getkey
+       note: the key events are decoded only once, into the lookahead buffer (max. KBDKBUF_SIZE key events,
+             the releases too), ps2_kbd_getevent, ps2_kbd_getline and ps2_kbd_getchar32 get them also
+
+   - uint8_t ps2_kbd_peek(uint32_t kbd_n) : look ahead the n. character without removing it (0 = next)
+       note: if return = 0 -> there are not n + 1 characters yet in the lookahead buffer
+
+   - uint8_t ps2_kbd_getevent(ps2_KbdEvent * kbd_event) : get one key event (press, release, repeat or hotkey)
+       note: if return = 0 -> there was no keyboard event
+             if return = 1 -> &kbd_event = key event (HID usage code, press/release,
+                              modifiers, lock status, character code; see typedef ps2_KbdEvent)
+
+   - uint8_t ps2_kbd_getchar32(uint32_t * kbd_char) : get one unicode character (with dead keys)
+       note: if return = 0 -> there was no character
+             if return = 1 -> &kbd_char = unicode code point (the language independent keys
+                              F1..F12, arrows, page up/down, insert, delete, home, end: PS2_UNI_KEY(PS2_F1...))
+
+   - uint8_t ps2_kbd_getutf8(uint8_t * kbd_utf8) : get one character in UTF-8 (as ps2_kbd_getchar32)
+       note: if return = 0 -> there was no character
+             if return = 1..4 -> kbd_utf8[0..return-1] = UTF-8 bytes (the buffer min. 4 bytes, not 0 terminated)
+
+   - uint8_t ps2_kbd_getcard(ps2_KbdCard * kbd_card) : get one magnetic stripe card (KBD_MAGSTRIPE == 1)
+       note: if return = 0 -> there was no card
+             if return = 1 -> &kbd_card = tracks 1..3 (0 terminated, without the sentinels) and track status (PS2_TRACK_...)
+
+   - void ps2_kbd_lineinit(ps2_KbdLine * kbd_line, uint8_t * kbd_buf, uint32_t kbd_size) : line input init
+       param: line input state, line buffer (max. kbd_size - 1 characters + 0 terminator)
+
+   - uint8_t * ps2_kbd_getline(ps2_KbdLine * kbd_line, uint32_t * kbd_len) : line input (one call / line)
+       note: the waiting key events are edited in the line buffer (backspace, delete, left, right, home, end,
+             insert, esc), the cursor: kbd_line->pos, the actual length: kbd_line->len
+             if return = NULL -> the line is not complete yet (enter)
+             if return = kbd_buf -> 0 terminated line, &kbd_len = line length (the next call starts a new line)
+
+   - uint32_t ps2_kbd_getstring(uint8_t * kbd_str, uint32_t kbd_len) : get one barcode scanner string (KBD_SCANNER >= 1)
+       note: if return = 0 -> there was no string (or kbd_len = 0, the string remains)
+             if return = n -> kbd_str = 0 terminated string (max. kbd_len - 1 characters, without the terminator)
+
+   - uint8_t ps2_kbd_setkeymap(uint8_t kbd_keymap) : set the active keymap (language)
+       param: PS2_KEYMAP_US or PS2_KEYMAP_D or PS2_KEYMAP_HU
+       note: if return = 0 -> the keymap is not linked (see KEYMAP_... in ps2_codepage.h)
+
    - uint8_t ps2_kbd_getscan(uint8_t * kbd_scan) : get one scancode
        note: if return = 0 -> there was no keyboard event
              if return = 1 -> &kbd_scan = scan code
 
-   - uint8_t ps2_kbd_ctrlstatus(void) : get the modify buttons status
+   - uint8_t ps2_kbd_iskeydown(uint8_t kbd_usage) : is the key pressed now (O(1) bitmap test)
+       param: HID usage code (see the keyboard HID usage codes)
+       return = 0 -> released, 1 -> pressed
+
+   - void ps2_kbd_getkeydown(uint32_t * kbd_keys) : atomic snapshot of the pressed keys bitmap
+       param: pointer to 8 x 32 bits (32 bytes) array (bit n = HID usage n)
+
+   - uint8_t ps2_kbd_ctrlstatus(void) : get the modify buttons status (all 8 modifiers, left and right)
        return = buttons status (see the modify buttons statusbits)
 
    - uint8_t ps2_kbd_lockstatus(void) : get the keyboard lock status (caps lock, num lock, scroll lock)
@@ -28,11 +77,59 @@ extern "C" {
 
    - uint8_t ps2_kbd_setlocks(uint8_t kbd_locks) : set the keyboard lock status
        param: lock status (see the lock buttons statusbits and leds)
+       note: not blocking, the LEDs are updated in the background (the fast changes are collapsed into one update)
+
+   - uint8_t ps2_kbd_ledsynced(void) : are the keyboard LEDs updated
+       return = 0 -> the LED update is in progress, 1 -> the keyboard LEDs = lock status
+
+   - uint8_t ps2_kbd_connected(void) : get the keyboard connection status (KBD_HOTPLUG == 1)
+       return = 0 -> the keyboard is disconnected, 1 -> connected
+
+   - uint8_t ps2_kbd_addhotkey(uint8_t kbd_mods, const uint8_t * kbd_keys, uint8_t kbd_len, uint8_t kbd_id) : add hotkey
+       param: modifiers (PS2_KMOD_...), keys (HID usage codes, 1 key: chord, more keys: sequence), number of keys, id
+       note: the hotkeys are matched in the decoder, instead of the key press -> PS2_KEV_HOTKEY event (usage = id)
+             if return = 0 -> no more space (KBD_HOTKEYS, nothing is added) or the sequence is the prefix of an other
+                              hotkey or an other hotkey is the prefix of it (e.g. Ctrl+K and Ctrl+K, Ctrl+C)
+
+   - void ps2_kbd_delhotkeys(void) : delete all hotkeys
+
+   - uint8_t ps2_kbd_setscanset(uint8_t kbd_set) : switch the keyboard to scan code set 2 or 3 (KBD_SCANSET3 >= 1)
+       note: set 3: the character keys make only, the modifiers make/break (the keyboard answers are checked,
+             if the keyboard does not know set 3 -> set 2)
+
+   - uint8_t ps2_kbd_getscanset(void) : get the active scan code set
+       return = 0 -> the setting is in progress, 2 or 3 -> scan code set
+
+   - uint8_t ps2_kbd_settypematic(uint8_t kbd_typematic) : set the keyboard typematic rate and delay
+       param: PS2_TYPEMATIC_DELAY_250..1000 | rate (0x00 = 30 characters/sec ... 0x1F = 2 characters/sec)
+
+   - uint8_t ps2_kbd_setswrepeat(uint16_t kbd_delay, uint16_t kbd_period) : set the software repeat (KBD_SWREPEAT == 1)
+       param: first repeat delay (ms), repeat period (ms, 0 = repeat off)
+       note: if return = 0 -> no software repeat (KBD_SWREPEAT == 0)
 
    - void ps2_kbd_cbrx(uint8_t rx_data) : this callback function may indicate
        that data has been received from the keyboard
        attention: it will be operated from an interruption !
 
+   - void ps2_kbd_cbstring(uint8_t * str, uint32_t len) : this callback function may indicate
+       that a barcode scanner string is complete (KBD_SCANNER >= 1, str: 0 terminated)
+       attention: it will be operated from an interruption (or from ps2_kbd_getstring at timeout) !
+
+   - void ps2_kbd_cbcard(ps2_KbdCard * card) : this callback function may indicate
+       that a magnetic stripe card is complete (KBD_MAGSTRIPE == 1)
+       attention: it will be operated from an interruption (or from ps2_kbd_getcard / ps2_kbd_getevent at timeout) !
+
+   - void ps2_kbd_cbstatus(uint8_t kbd_mods, uint8_t kbd_locks) : this callback function may indicate
+       that a modify button or a lock status changed (kbd_mods: modify buttons statusbits, kbd_locks: lock buttons statusbits)
+       attention: the lock changes (and if KBD_RXDECODE == 1 the modify button changes) will be operated from an interruption !
+
+   - void ps2_kbd_cbhotkey(uint8_t id) : this callback function may indicate the registered hotkey
+       attention: if KBD_RXDECODE == 1 it will be operated from an interruption !
+
+   - void ps2_kbd_cbconnect(uint8_t kbd_connected) : this callback function may indicate
+       that the keyboard is plugged in (kbd_connected = 1) or unplugged (kbd_connected = 0) (KBD_HOTPLUG == 1)
+       attention: the connect will be operated from an interruption !
+
    - void ps2_kbd_cbrxerror(uint32_t rx_errorcode) : if you want to know that an keyboard RX buffer is overflowed
        or parity error occurred, do a function with that name
        note: see the ps2 error codes
@@ -44,6 +141,21 @@ extern "C" {
        param: pointer to ps2_MouseData type variable
        if return = 0 -> there was no mouse event
        if return = 1 -> the mouse event data is placed in the variable (see typedef ps2_MouseData)
+       note: the mouse init (reset, wheel and 5 button mouse detection) runs in the background without waiting,
+             the function returns 0 until the mouse is ready or after the mouse is reinitialized (command error, no answer)
+
+   - uint8_t ps2_mouse_setmethod(uint8_t mouse_method) : get move method change at run time (without mouse reset)
+       param: 1, 2 (remote mode), 3 (stream mode), see MOUSE_METHOD
+       if return = 0 -> invalid method
+       if return = 1 -> the mouse mode will be changed in the next ps2_mouse_getmove calls
+       note: the mouse output format is the same in all methods
+
+   - uint32_t ps2_mouse_getevents(ps2_MouseEvent * mouse_events, uint32_t mouse_maxnum) : get the mouse packets
+       one by one with time stamp (if MOUSE_EVENTS == 1 and method 3)
+       param: pointer to ps2_MouseEvent type array, array size
+       return: the number of the events placed in the array (0 = there was no mouse event)
+       note: ps2_mouse_getmove (method 3) reads the same packets, do not use both
+       note: the packets are not summarized, the motion trajectory and timing can be read
 
    - void ps2_mouse_cbrx(uint32_t rx_datanum) : this callback function may indicate
        that data pack has been received from the keyboard (parameter = data packet size)
@@ -81,9 +193,81 @@ extern "C" {
 /* keyboard buffer size (8,16,32,64,128,256,512,1024,2048,...)
    - KBDRBUF_SIZE: recommended minimum 32
    - KBDTBUF_SIZE: enough 8
+   - KBDKBUF_SIZE: decoded key events lookahead (ps2_kbd_peek, ps2_kbd_available, the releases are stored also), min. 2
      note: the buffer size should be (2 ^ n) ! */
 #define KBDRBUF_SIZE      32
 #define KBDTBUF_SIZE       8
+#define KBDKBUF_SIZE      16
+
+/* keyboard decode method
+   - 0: the RX buffer holds the scan codes, they are decoded in ps2_kbd_getevent / ps2_kbd_getkey
+   - 1: the scan codes are decoded in the keyboard RX interrupt, the RX buffer holds the key events
+        (16 bits / key event, one buffer read / key, ps2_kbd_getscan not usable -> see ps2_kbd_cbrx)
+     note: method 0: KBDRBUF_SIZE = scan code bytes (key press + release: 3..5 bytes)
+           method 1: KBDRBUF_SIZE = key events (key press + release: 2 events, 1 event if KBD_RXBREAKS = 0) */
+#define KBD_RXDECODE       0
+
+/* (only if KBD_RXDECODE == 1) key release events to the RX buffer
+   - 0: only the key press events (enough for ps2_kbd_getkey, the events contain the modifiers)
+   - 1: key press and release events */
+#define KBD_RXBREAKS       1
+
+/* barcode scanner (keyboard wedge) mode (only if KBD_RXDECODE == 1)
+   - 0: off
+   - 1: the characters are assembled to strings in the keyboard RX interrupt (ps2_kbd_getstring, ps2_kbd_cbstring),
+        a string ends at the terminator character or after the inter character timeout
+        (the character keys and the modifier keys inside a string do not go to the RX buffer, neither their releases)
+   - 2: human and scanner on the same keyboard port, the key runs are classified by the inter character time:
+        scanner (min. KBD_SCANNER_MINBURST characters, each within KBD_SCANNER_TIMEOUT) -> string,
+        human -> key events (the human keys are delayed max. KBD_SCANNER_TIMEOUT until the classification) */
+#define KBD_SCANNER        0
+#define KBD_SCANNER_BUFSIZE  128  /* completed strings buffer size (2 ^ n bytes, the strings + 0 terminators) */
+#define KBD_SCANNER_MAXLEN    64  /* max string length (the longer string is truncated) */
+#define KBD_SCANNER_TERM1    PS2_ENTER  /* string terminator characters (0 = not used) */
+#define KBD_SCANNER_TERM2    PS2_TAB
+#define KBD_SCANNER_TIMEOUT   50  /* inter character timeout (ms, 0 = only the terminator characters, KBD_SCANNER 2: min. 1) */
+#define KBD_SCANNER_MINBURST   6  /* KBD_SCANNER 2: fast characters for the scanner classification */
+#define KBD_SCANNER_HOLD      24  /* KBD_SCANNER 2: held key events until the classification (min. 2 * KBD_SCANNER_MINBURST) */
+
+/* magnetic stripe card reader (keyboard wedge: %track1? ;track2? ;track3? or +track3?, optional LRC after the ?)
+   - 0: no card reader
+   - 1: the tracks are captured in the keyboard RX interrupt (needs KBD_RXDECODE 1, not possible with KBD_SCANNER),
+        the complete card: ps2_kbd_getcard, ps2_kbd_cbcard (the card characters do not go to the RX buffer)
+        the start sentinel character of a human is delayed max. KBD_MAGSTRIPE_TIMEOUT,
+        fast typed keys without end sentinel (e.g. ";12") are delayed and then go to the RX buffer as normal keys */
+#define KBD_MAGSTRIPE      0
+#define KBD_MAGSTRIPE_TRACKLEN 107  /* max. track length (track 1: 79, track 2: 40, track 3: 107 characters) */
+#define KBD_MAGSTRIPE_TIMEOUT   50  /* inter character timeout (ms): the end of the card (if no enter) */
+
+/* keyboard scan code set 3 (the character keys make only, the modifiers make/break: about half the PS2 frames)
+   - 0: only scan code set 2
+   - 1: set 3 can be switched with ps2_kbd_setscanset (if the keyboard does not know it: set 2)
+   - 2: as 1, and set 3 is switched at the start
+     note: the make only keys have no release event, no typematic repeat and not in the pressed keys bitmap */
+#define KBD_SCANSET3       0
+
+/* hotkeys (chords and key sequences, see ps2_kbd_addhotkey)
+   - 0: no hotkeys
+   - n: max. number of the hotkey trie nodes (one node / key of a sequence, the common prefixes are shared, max. 255) */
+#define KBD_HOTKEYS       16
+
+/* keyboard autorepeat
+   - 0: keyboard (typematic) repeat (rate and delay: ps2_kbd_settypematic)
+   - 1: software repeat: the keyboard is set to the slowest typematic and its repeats are dropped,
+        the last pressed key repeats from the pressed keys bitmap in ps2_kbd_getevent
+        (rate and delay: KBD_SWREPEAT_DELAY, KBD_SWREPEAT_PERIOD or ps2_kbd_setswrepeat) */
+#define KBD_SWREPEAT       0
+#define KBD_SWREPEAT_DELAY   500  /* first repeat delay (ms) */
+#define KBD_SWREPEAT_PERIOD   33  /* repeat period (ms, 33 = 30 characters/sec) */
+
+/* keyboard hot-plug
+   - 0: no hot-plug detection
+   - 1: the keyboard BAT (0xAA, after plugging in) -> connect, the LEDs, typematic and scan code set are restored
+        in the background, no answer to a command (after the resends) -> disconnect,
+        the disconnected keyboard is probed with echo, any received byte -> connect, the settings are applied again
+        (ps2_kbd_connected, ps2_kbd_cbconnect) */
+#define KBD_HOTPLUG        0
+#define KBD_HOTPLUG_POLL  1000  /* the silent keyboard is checked with echo after this time (ms, 0 = no echo) */
 
 /* mouse clock and port name, pin number (A..K, 0..15) */
 #define PS2_MOUSECLK    X, 0  /* If not used leave it that way */
@@ -94,8 +278,8 @@ extern "C" {
 #define MOUSERBUF_SIZE    64
 #define MOUSETBUF_SIZE     8
 
-/* mouse get move method
-   - 1: waiting for the mouse to respond
+/* mouse get move method (default, it can be changed with ps2_mouse_setmethod)
+   - 1: read data command, then ps2_mouse_getmove returns 0 until the packet arrives (no waiting in the call)
    - 2: returns the result of the previous query immediately and then starts the new query
    - 3: enable the continuous mouse reporting (there is only CPU usage time when we move or press the mouse)
      note: method 1 and 2: enough MOUSERBUF_SIZE number = 8
@@ -103,6 +287,46 @@ extern "C" {
            all method: enough MOUSETBUF_SIZE number = 8 */
 #define MOUSE_METHOD       3
 
+/* method 3 packet summarizing limits (one ps2_mouse_getmove call, the summarizing always stops at button change)
+   - MOUSE_SUM_PACKETS: max. packet number (0 = all packets in the receive buffer)
+   - MOUSE_SUM_AGE: max. time between the first and the last packet receive time (ms, 0 = no limit)
+       note: the receive time of the packets is stored (MOUSERBUF_SIZE * 2 bytes RAM)
+   - MOUSE_SUM_DELTA: max. X or Y move (0 = no limit)
+   - MOUSE_SUM_WHEELBREAK: 0 = the wheel moves are summarized, 1 = stop after the packet with wheel move */
+#define MOUSE_SUM_PACKETS     0
+#define MOUSE_SUM_AGE         0
+#define MOUSE_SUM_DELTA       0
+#define MOUSE_SUM_WHEELBREAK  0
+
+/* mouse pointer acceleration and axis transform (every packet, before the summarizing)
+   - MOUSE_ACCEL: 0 = raw mouse moves, 1 = acceleration and axis transform enabled
+   - MOUSE_ACCEL_LUT: gain table (fixed point, 256 = 1.0, max. 4096),
+       index = packet speed (the bigger of X and Y move) / MOUSE_ACCEL_STEP, the last gain above the table
+   - MOUSE_SWAPXY: 1 = swap the X and Y axis
+   - MOUSE_INVERTX, MOUSE_INVERTY: 1 = invert the axis (after the swap)
+   - MOUSE_SCALEX, MOUSE_SCALEY: axis scale (fixed point, 256 = 1.0, max. 4096)
+     note: the fractions of the moves are carried to the next packet */
+#define MOUSE_ACCEL        0
+#define MOUSE_ACCEL_STEP   2
+#define MOUSE_ACCEL_LUT    256, 256, 320, 384, 448, 512, 576, 640
+#define MOUSE_SWAPXY       0
+#define MOUSE_INVERTX      0
+#define MOUSE_INVERTY      0
+#define MOUSE_SCALEX     256
+#define MOUSE_SCALEY     256
+
+/* mouse event queue (ps2_mouse_getevents: every stream packet is one event with time stamp)
+   - 0: disabled
+   - 1: enabled, the receive time of the packets is stored (MOUSERBUF_SIZE * 2 bytes RAM)
+     note: only in method 3 (stream mode), ps2_mouse_getevents and ps2_mouse_getmove read the same RX buffer,
+           use only one of them */
+#define MOUSE_EVENTS       0
+
+/* get microseconds function name (mouse event time stamp, MOUSE_EVENTS == 1 or MOUSE_SUM_AGE > 0)
+     note: (PS2_GETTIME() * 1000 or a free running microsecond timer ...),
+           the default PS2_GETTIME() * 1000 has only 1 ms resolution */
+#define PS2_GETTIME_US()  (PS2_GETTIME() * 1000)
+
 // ============================================================================
 /* Fix chapter */
 
@@ -140,18 +364,94 @@ extern "C" {
 #define PS2_F12            156
 #define PS2_SCROLL           0
 
+/* keyboard HID usage codes (keyboard/keypad page, ps2_KbdEvent.usage)
+     note: letters: PS2_HID_A + 0..25, digits: PS2_HID_1 + 0..8, PS2_HID_0 */
+#define PS2_HID_A         0x04
+#define PS2_HID_1         0x1E
+#define PS2_HID_0         0x27
+#define PS2_HID_ENTER     0x28
+#define PS2_HID_ESC       0x29
+#define PS2_HID_BACKSPACE 0x2A
+#define PS2_HID_TAB       0x2B
+#define PS2_HID_SPACE     0x2C
+#define PS2_HID_CAPSLOCK  0x39
+#define PS2_HID_F1        0x3A  /* F1..F12: PS2_HID_F1 + 0..11 */
+#define PS2_HID_PRINTSCR  0x46
+#define PS2_HID_SCRLOCK   0x47
+#define PS2_HID_PAUSE     0x48
+#define PS2_HID_INSERT    0x49
+#define PS2_HID_HOME      0x4A
+#define PS2_HID_PAGEUP    0x4B
+#define PS2_HID_DELETE    0x4C
+#define PS2_HID_END       0x4D
+#define PS2_HID_PAGEDOWN  0x4E
+#define PS2_HID_RIGHT     0x4F
+#define PS2_HID_LEFT      0x50
+#define PS2_HID_DOWN      0x51
+#define PS2_HID_UP        0x52
+#define PS2_HID_NUMLOCK   0x53
+#define PS2_HID_KPENTER   0x58
+#define PS2_HID_APP       0x65
+#define PS2_HID_LCTRL     0xE0
+#define PS2_HID_LSHIFT    0xE1
+#define PS2_HID_LALT      0xE2
+#define PS2_HID_LGUI      0xE3
+#define PS2_HID_RCTRL     0xE4
+#define PS2_HID_RSHIFT    0xE5
+#define PS2_HID_RALT      0xE6  /* altgr */
+#define PS2_HID_RGUI      0xE7
+
+/* keyboard event types (ps2_KbdEvent.type) */
+#define PS2_KEV_MAKE         0  /* key pressed */
+#define PS2_KEV_BREAK        1  /* key released */
+#define PS2_KEV_REPEAT       2  /* typematic repeat (key held) */
+#define PS2_KEV_HOTKEY       3  /* registered hotkey (usage = hotkey id, see ps2_kbd_addhotkey) */
+
+/* keyboard typematic delay (ps2_kbd_settypematic) */
+#define PS2_TYPEMATIC_DELAY_250   0x00
+#define PS2_TYPEMATIC_DELAY_500   0x20
+#define PS2_TYPEMATIC_DELAY_750   0x40
+#define PS2_TYPEMATIC_DELAY_1000  0x60
+
+/* keyboard event modifier bits (ps2_KbdEvent.mods) */
+#define PS2_KMOD_SHIFT    0x01
+#define PS2_KMOD_CTRL     0x02
+#define PS2_KMOD_ALT      0x04
+#define PS2_KMOD_ALTGR    0x08
+
+/* language independent keys in unicode (ps2_kbd_getchar32: private use area U+E000..U+E0FF, e.g. PS2_UNI_KEY(PS2_LEFTARROW)) */
+#define PS2_UNI_KEY(c)    (0xE000 | (c))
+
+/* keyboard keymaps (ps2_kbd_setkeymap) */
+#define PS2_KEYMAP_US        0
+#define PS2_KEYMAP_D         1
+#define PS2_KEYMAP_HU        2
+
 /* keyboard lock buttons scan code */
 #define SCN_SCRLOCK       0x7E
 #define SCN_NUMLOCK       0x77
 #define SCN_CAPSLOCK      0x58
+#define SCN3_SCRLOCK      0x5F  /* scan code set 3 */
+#define SCN3_NUMLOCK      0x76
+#define SCN3_CAPSLOCK     0x14
 
-/* keyboard modify buttons statusbits (ctrl, shift, alt, altgr) */
+/* keyboard decoder statusbits */
 #define ST_KBDBREAK       0x01
 #define ST_KBDMODIFIER    0x02
-#define ST_KBDSHIFT_L     0x04
-#define ST_KBDSHIFT_R     0x08
-#define ST_KBDALTGR       0x10
-#define ST_KBDCTRL        0x20
+
+/* keyboard modify buttons statusbits (ps2_kbd_ctrlstatus, HID modifier byte order) */
+#define ST_KBDLCTRL       0x01
+#define ST_KBDLSHIFT      0x02
+#define ST_KBDLALT        0x04
+#define ST_KBDLGUI        0x08
+#define ST_KBDRCTRL       0x10
+#define ST_KBDRSHIFT      0x20
+#define ST_KBDRALT        0x40  /* altgr */
+#define ST_KBDRGUI        0x80
+#define ST_KBDSHIFT_L     ST_KBDLSHIFT
+#define ST_KBDSHIFT_R     ST_KBDRSHIFT
+#define ST_KBDALTGR       ST_KBDRALT
+#define ST_KBDCTRL        (ST_KBDLCTRL | ST_KBDRCTRL)
 
 /* keyboard lock buttons statusbits (capslock, numlock, scrollock) */
 #define ST_KBDSCRLOCK     0x01
@@ -160,25 +460,101 @@ extern "C" {
 
 //-----------------------------------------------------------------------------
 /* keyboard */
+typedef struct
+{
+  uint8_t  type;    /* event type (see the keyboard event types) */
+  uint8_t  usage;   /* HID usage code (see the keyboard HID usage codes) */
+  uint8_t  mods;    /* modifier buttons at the event (see the keyboard event modifier bits) */
+  uint8_t  locks;   /* lock status at the event (see the lock buttons statusbits) */
+  uint8_t  ch;      /* character code (as ps2_kbd_getkey, 0 = no character or release) */
+}ps2_KbdEvent;
+
+uint8_t ps2_kbd_getevent(ps2_KbdEvent * kbd_event); /* get keyboard event (if return == 1 -> *kbd_event = keyboard event) */
 uint8_t ps2_kbd_getkey(uint8_t * kbd_key);        /* get keyboard ascII code (if return == 1 -> *kbd_key = keyboard ascII code) */
+uint32_t ps2_kbd_available(void);                 /* number of the decoded characters (in max. KBDKBUF_SIZE key events) */
+uint8_t ps2_kbd_peek(uint32_t kbd_n);             /* look ahead the n. character (0 = next, return 0 = not available) */
+
+/* line input state (see ps2_kbd_lineinit, ps2_kbd_getline) */
+typedef struct
+{
+  uint8_t * buf;    /* line buffer (caller supplied) */
+  uint32_t  size;   /* line buffer size */
+  uint32_t  len;    /* line length */
+  uint32_t  pos;    /* cursor position (0..len) */
+  uint8_t   ovr;    /* 0 = insert mode, 1 = overwrite mode (insert key) */
+  uint8_t   done;   /* 1 = the line is complete */
+}ps2_KbdLine;
+
+void    ps2_kbd_lineinit(ps2_KbdLine * kbd_line, uint8_t * kbd_buf, uint32_t kbd_size); /* line input init */
+uint8_t * ps2_kbd_getline(ps2_KbdLine * kbd_line, uint32_t * kbd_len); /* line input (return: NULL = not complete, else: the line) */
+uint8_t ps2_kbd_getchar32(uint32_t * kbd_char);  /* get keyboard unicode character (if return == 1 -> *kbd_char = unicode code point) */
+uint8_t ps2_kbd_getutf8(uint8_t * kbd_utf8);      /* get keyboard character in UTF-8 (return: 0 = none, 1..4 = *kbd_utf8 byte count) */
+uint8_t ps2_kbd_iskeydown(uint8_t kbd_usage);     /* is the key pressed (kbd_usage = HID usage code, return: 0 = released, 1 = pressed) */
+void    ps2_kbd_getkeydown(uint32_t * kbd_keys);  /* get the pressed keys bitmap (kbd_keys = 8 x 32 bits, bit n = HID usage n) */
+uint8_t ps2_kbd_setkeymap(uint8_t kbd_keymap);    /* set the keymap (PS2_KEYMAP_US, PS2_KEYMAP_D, PS2_KEYMAP_HU, return: 0 = not linked, 1 = ok) */
 uint8_t ps2_kbd_getscan(uint8_t * kbd_scan);      /* get keyboard scan code (if return == 1 -> *kbd_scan = keyboard scan code) */
 uint8_t ps2_kbd_ctrlstatus(void);                 /* get keyboard ctrl status (return = keyboard modify buttons statusbits) */
 uint8_t ps2_kbd_lockstatus(void);                 /* get keyboard lock status (return = keyboard lock buttons statusbits) */
-uint8_t ps2_kbd_setlocks(uint8_t kbd_locks);      /* set keyboard lock status (return = keyboard lock buttons statusbits) */
+uint8_t ps2_kbd_setlocks(uint8_t kbd_locks);      /* set keyboard lock status (not blocking, return: 1 = ok) */
+uint8_t ps2_kbd_ledsynced(void);                  /* keyboard LEDs updated (return: 0 = in progress, 1 = the LEDs = lock status) */
+uint8_t ps2_kbd_connected(void);                  /* keyboard connection status (return: 0 = disconnected, 1 = connected) */
+uint8_t ps2_kbd_addhotkey(uint8_t kbd_mods, const uint8_t * kbd_keys, uint8_t kbd_len, uint8_t kbd_id); /* add hotkey (return: 0 = full, 1 = ok) */
+void    ps2_kbd_delhotkeys(void);                 /* delete all hotkeys */
+__weak  void ps2_kbd_cbstatus(uint8_t kbd_mods, uint8_t kbd_locks); /* callback function for modify buttons or lock status change */
+__weak  void ps2_kbd_cbhotkey(uint8_t id);        /* callback function for hotkey (id: see ps2_kbd_addhotkey) */
+__weak  void ps2_kbd_cbconnect(uint8_t kbd_connected); /* callback function for keyboard plug in / unplug */
+uint8_t ps2_kbd_setscanset(uint8_t kbd_set);     /* set scan code set (2 or 3, return: 0 = busy or not linked, 1 = started) */
+uint8_t ps2_kbd_getscanset(void);                 /* get scan code set (return: 0 = setting in progress, 2 or 3) */
+uint8_t ps2_kbd_settypematic(uint8_t kbd_typematic); /* set keyboard typematic (PS2_TYPEMATIC_DELAY_xxx | rate 0x00..0x1F) */
+uint8_t ps2_kbd_setswrepeat(uint16_t kbd_delay, uint16_t kbd_period); /* set software repeat (ms, KBD_SWREPEAT == 1) */
 __weak  void ps2_kbd_cbrx(uint8_t rx_data);       /* callback function for keyboard RX data (scan codes) */
 __weak  void ps2_kbd_cbrxerror(uint32_t rx_errorcode); /* callback function for keyboard RX error (see PS2_ERROR... macros) */
+uint32_t ps2_kbd_getstring(uint8_t * kbd_str, uint32_t kbd_len); /* get barcode scanner string (return: 0 = none, n = string length) */
+__weak  void ps2_kbd_cbstring(uint8_t * str, uint32_t len); /* callback function for barcode scanner string (KBD_SCANNER >= 1) */
+
+/* magnetic stripe track status */
+#define PS2_TRACK_NONE       0  /* the track is not on the card */
+#define PS2_TRACK_OK         1  /* the track is read (no LRC) */
+#define PS2_TRACK_LRCOK      2  /* the track is read, the LRC is good */
+#define PS2_TRACK_LRCERR     3  /* the track is read, LRC error */
+#define PS2_TRACK_ERR        4  /* no end sentinel or too long track */
+
+/* magnetic stripe card (see ps2_kbd_getcard) */
+typedef struct
+{
+  uint8_t  track[3][KBD_MAGSTRIPE_TRACKLEN + 1]; /* track 1..3 data (0 terminated, without the sentinels and LRC) */
+  uint8_t  len[3];    /* track 1..3 length */
+  uint8_t  status[3]; /* track 1..3 status (PS2_TRACK_...) */
+}ps2_KbdCard;
+
+uint8_t ps2_kbd_getcard(ps2_KbdCard * kbd_card);  /* get magnetic stripe card (return: 0 = none, 1 = card) */
+__weak  void ps2_kbd_cbcard(ps2_KbdCard * card);  /* callback function for magnetic stripe card (KBD_MAGSTRIPE == 1) */
 
 //-----------------------------------------------------------------------------
 /* mouse */
 typedef struct
 {
-  int16_t  xmove;   /* X coordinate */
-  int16_t  ymove;   /* Y coordinate */
+  int32_t  xmove;   /* X coordinate */
+  int32_t  ymove;   /* Y coordinate */
   int16_t  zmove;   /* mouse wheel */
-  int8_t   btns;    /* buttons (in 3 smallest bits) */
+  int16_t  wmove;   /* horizontal mouse wheel (ID 4 mouse) */
+  int8_t   btns;    /* buttons (bit 0..2: left, right, middle, bit 3..4: 4th, 5th button (ID 4 mouse)) */
 }ps2_MouseData;
 
 uint8_t ps2_mouse_getmove(ps2_MouseData * mouse_data);    /* get mouse move data (if return == 1 -> *mouse_data = mouse move data) */
+uint8_t ps2_mouse_setmethod(uint8_t mouse_method);        /* get move method change (1, 2, 3, see MOUSE_METHOD) */
+
+typedef struct
+{
+  uint32_t t_us;    /* receive time of the packet (us, see PS2_GETTIME_US) */
+  int16_t  dx;      /* X move */
+  int16_t  dy;      /* Y move */
+  int8_t   dz;      /* mouse wheel */
+  int8_t   dw;      /* horizontal mouse wheel (ID 4 mouse) */
+  uint8_t  btns;    /* buttons (see ps2_MouseData) */
+}ps2_MouseEvent;
+
+uint32_t ps2_mouse_getevents(ps2_MouseEvent * mouse_events, uint32_t mouse_maxnum); /* get mouse events (MOUSE_EVENTS == 1, return: event number) */
 __weak  void ps2_mouse_cbrx(uint32_t rx_datanum);         /* callback function for mouse RX data */
 __weak  void ps2_mouse_cbrxerror(uint32_t rx_errorcode);  /* callback function for mouse RX error (see PS2_ERROR... macros) */
 
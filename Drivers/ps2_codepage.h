@@ -5,240 +5,304 @@
 
 #if ((defined PS2_KBDCLK) && (defined PS2_KBDDATA))
 
-/* KEYMAP_US or KEYMAP_D or KEYMAP_HU */
-#define KEYMAP_US
+/* linked keymaps (0 = not linked, 1 = linked)
+     note: the active keymap can be changed with ps2_kbd_setkeymap (PS2_KEYMAP_US or PS2_KEYMAP_D or PS2_KEYMAP_HU) */
+#define KEYMAP_US            1
+#define KEYMAP_D             1
+#define KEYMAP_HU            1
 
-#define PS2_MAINKEYMAP_SIZE  104
-#define PS2_NUMKEYMAP_SIZE    32
+/* keymap after the start (PS2_KEYMAP_US or PS2_KEYMAP_D or PS2_KEYMAP_HU) */
+#define KEYMAP_DEFAULT       PS2_KEYMAP_US
+
+/* unicode tables and dead keys (ps2_kbd_getchar32, ps2_kbd_getutf8)
+   - 0: not linked (the 8 bit character codes are returned as unicode, no dead keys)
+   - 1: linked (codepage -> unicode tables, dead keys, compose table) */
+#define KEYMAP_UNICODE       1
+
+/* 8 bit character codes (KEYMAP_HU: Windows-1250, KEYMAP_D: Windows-1252 codepage) */
+#define PS2_EURO_SIGN           0x80
+#define PS2_CARON               0xA1  /* 1250 */
+#define PS2_BREVE               0xA2  /* 1250 */
+#define PS2_L_STROKE            0xA3  /* 1250 */
+#define PS2_SECTION_SIGN        0xA7
+#define PS2_DIAERESIS           0xA8
+#define PS2_DEGREE_SIGN         0xB0
+#define PS2_OGONEK              0xB2  /* 1250 */
+#define PS2_SUPERSCRIPT_TWO     0xB2  /* 1252 */
+#define PS2_l_STROKE            0xB3  /* 1250 */
+#define PS2_SUPERSCRIPT_THREE   0xB3  /* 1252 */
+#define PS2_ACUTE_ACCENT        0xB4
+#define PS2_MICRO_SIGN          0xB5
+#define PS2_CEDILLA             0xB8
+#define PS2_DOUBLE_ACUTE        0xBD  /* 1250 */
+#define PS2_A_ACUTE             0xC1
+#define PS2_A_DIAERESIS         0xC4
+#define PS2_E_ACUTE             0xC9
+#define PS2_I_ACUTE             0xCD
+#define PS2_D_STROKE            0xD0  /* 1250 */
+#define PS2_O_ACUTE             0xD3
+#define PS2_O_DOUBLE_ACUTE      0xD5  /* 1250 */
+#define PS2_O_DIAERESIS         0xD6
+#define PS2_U_ACUTE             0xDA
+#define PS2_U_DOUBLE_ACUTE      0xDB  /* 1250 */
+#define PS2_U_DIAERESIS         0xDC
+#define PS2_SHARP_S             0xDF
+#define PS2_a_ACUTE             0xE1
+#define PS2_a_DIAERESIS         0xE4
+#define PS2_e_ACUTE             0xE9
+#define PS2_i_ACUTE             0xED
+#define PS2_d_STROKE            0xF0  /* 1250 */
+#define PS2_o_ACUTE             0xF3
+#define PS2_o_DOUBLE_ACUTE      0xF5  /* 1250 */
+#define PS2_o_DIAERESIS         0xF6
+#define PS2_DIVISION_SIGN       0xF7
+#define PS2_u_ACUTE             0xFA
+#define PS2_u_DOUBLE_ACUTE      0xFB  /* 1250 */
+#define PS2_u_DIAERESIS         0xFC
+#define PS2_DOT_ABOVE           0xFF  /* 1250 */
+
+/* keymap plane index: HID usage 0x04..0x38 -> 0..52, HID usage 0x64 (non-US \) -> 53 */
+#define PS2_KEYMAP_SIZE       54
+#define PS2_KEYMAP_LAST     0x38
+#define PS2_KEYMAP_NONUS    0x64
+#define PS2_KEYMAP_FLAGSIZE    ((PS2_KEYMAP_SIZE + 7) / 8)
 typedef struct {
-  uint8_t noshift[PS2_MAINKEYMAP_SIZE];
-  uint8_t shift[PS2_MAINKEYMAP_SIZE];
-  uint8_t noshiftcaps[PS2_MAINKEYMAP_SIZE];
-  uint8_t shiftcaps[PS2_MAINKEYMAP_SIZE];
-  uint8_t numoff[PS2_NUMKEYMAP_SIZE];
-  uint8_t numon[PS2_NUMKEYMAP_SIZE];
-  uint8_t uses_altgr;
-  uint8_t altgr[PS2_MAINKEYMAP_SIZE];
+  const uint8_t * noshift;
+  const uint8_t * shift;
+  const uint8_t * altgr;                /* NULL: the keymap not uses the altgr */
+  uint8_t         caps[PS2_KEYMAP_FLAGSIZE]; /* bit n = 1: the caps lock inverts the shift on the plane index n key (letters) */
+  const uint8_t * capsexc;              /* caps lock exceptions ({index, noshift+caps, shift+caps}, ..., 0xFF), NULL: none */
+  const uint16_t * unicode;             /* character code 0x80..0xFF -> unicode, NULL: 8 bit code = unicode */
+  const uint8_t * deadkeys;             /* dead key character codes (..., 0), NULL: none */
 } PS2Keymap_t;
 
-#ifdef KEYMAP_US
-const PS2Keymap_t keymap = {
-  // noshift
-  {0, PS2_F9, 0, PS2_F5, PS2_F3, PS2_F1, PS2_F2, PS2_F12,
-  0, PS2_F10, PS2_F8, PS2_F6, PS2_F4, PS2_TAB, '`', 0,
-  0, 0 /*Lalt*/, 0 /*Lshift*/, 0, 0 /*Lctrl*/, 'q', '1', 0,
-  0, 0, 'z', 's', 'a', 'w', '2', 0,
-  0, 'c', 'x', 'd', 'e', '4', '3', 0,
-  0, ' ', 'v', 'f', 't', 'r', '5', 0,
-  0, 'n', 'b', 'h', 'g', 'y', '6', 0,
-  0, 0, 'm', 'j', 'u', '7', '8', 0,
-  0, ',', 'k', 'i', 'o', '0', '9', 0,
-  0, '.', '/', 'l', ';', 'p', '-', 0,
-  0, 0, '\'', 0, '[', '=', 0, 0,
-  0 /*CapsLock*/, 0 /*Rshift*/, PS2_ENTER /*Enter*/, ']', 0, '\\', 0, 0,
-  0, 0, 0, 0, 0, 0, PS2_BACKSPACE, 0},
-  // shift
-  {0, PS2_F9, 0, PS2_F5, PS2_F3, PS2_F1, PS2_F2, PS2_F12,
-  0, PS2_F10, PS2_F8, PS2_F6, PS2_F4, PS2_TAB, '~', 0,
-  0, 0 /*Lalt*/, 0 /*Lshift*/, 0, 0 /*Lctrl*/, 'Q', '!', 0,
-  0, 0, 'Z', 'S', 'A', 'W', '@', 0,
-  0, 'C', 'X', 'D', 'E', '$', '#', 0,
-  0, ' ', 'V', 'F', 'T', 'R', '%', 0,
-  0, 'N', 'B', 'H', 'G', 'Y', '^', 0,
-  0, 0, 'M', 'J', 'U', '&', '*', 0,
-  0, '<', 'K', 'I', 'O', ')', '(', 0,
-  0, '>', '?', 'L', ':', 'P', '_', 0,
-  0, 0, '"', 0, '{', '+', 0, 0,
-  0 /*CapsLock*/, 0 /*Rshift*/, PS2_ENTER /*Enter*/, '}', 0, '|', 0, 0,
-  0, 0, 0, 0, 0, 0, PS2_BACKSPACE, 0},
-  // noshiftcaps
-  {0, PS2_F9, 0, PS2_F5, PS2_F3, PS2_F1, PS2_F2, PS2_F12,
-  0, PS2_F10, PS2_F8, PS2_F6, PS2_F4, PS2_TAB, '`', 0,
-  0, 0 /*Lalt*/, 0 /*Lshift*/, 0, 0 /*Lctrl*/, 'Q', '1', 0,
-  0, 0, 'Z', 'S', 'A', 'W', '2', 0,
-  0, 'C', 'X', 'D', 'E', '4', '3', 0,
-  0, ' ', 'V', 'F', 'T', 'R', '5', 0,
-  0, 'N', 'B', 'H', 'G', 'Y', '6', 0,
-  0, 0, 'M', 'J', 'U', '7', '8', 0,
-  0, ',', 'K', 'I', 'o', '0', '9', 0,
-  0, '.', '/', 'L', ';', 'P', '-', 0,
-  0, 0, '\'', 0, '[', '=', 0, 0,
-  0 /*CapsLock*/, 0 /*Rshift*/, PS2_ENTER /*Enter*/, ']', 0, '\\', 0, 0,
-  0, 0, 0, 0, 0, 0, PS2_BACKSPACE, 0},
-  // shiftcaps
-  {0, PS2_F9, 0, PS2_F5, PS2_F3, PS2_F1, PS2_F2, PS2_F12,
-  0, PS2_F10, PS2_F8, PS2_F6, PS2_F4, PS2_TAB, '~', 0,
-  0, 0 /*Lalt*/, 0 /*Lshift*/, 0, 0 /*Lctrl*/, 'q', '!', 0,
-  0, 0, 'z', 's', 'a', 'w', '@', 0,
-  0, 'c', 'x', 'd', 'e', '$', '#', 0,
-  0, ' ', 'v', 'f', 't', 'r', '%', 0,
-  0, 'n', 'b', 'h', 'g', 'y', '^', 0,
-  0, 0, 'm', 'j', 'u', '&', '*', 0,
-  0, '<', 'k', 'i', 'O', ')', '(', 0,
-  0, '>', '?', 'l', ':', 'p', '_', 0,
-  0, 0, '"', 0, '{', '+', 0, 0,
-  0 /*CapsLock*/, 0 /*Rshift*/, PS2_ENTER /*Enter*/, '}', 0, '|', 0, 0,
-  0, 0, 0, 0, 0, 0, PS2_BACKSPACE, 0},
-  // numoff
-  {0, '1', 0, '4', '7', 0, 0, 0,
-  '0', '.', '2', '5', '6', '8', PS2_ESC, 0 /*NumLock*/,
-  PS2_F11, '+', '3', '-', '*', '9', PS2_SCROLL, 0,
-  0, 0, 0, PS2_F7 },
-  // numon
-  {0, '1', 0, '4', '7', 0, 0, 0,
-  '0', '.', '2', '5', '6', '8', PS2_ESC, 0 /*NumLock*/,
-  PS2_F11, '+', '3', '-', '*', '9', PS2_SCROLL, 0,
-  0, 0, 0, PS2_F7 },
-  // uses_altgr
-  0
-};
+#if KEYMAP_UNICODE == 1
+#define PS2_KEYMAP_UNICODE(unicode, deadkeys)  unicode, deadkeys
+#else
+#define PS2_KEYMAP_UNICODE(unicode, deadkeys)  NULL, NULL
+#endif
+
+/* language independent keys (HID usage 0x39..0x63, numeric keypad without numlock) */
+#define PS2_FIXKEYMAP_FIRST   0x39
+static const uint8_t keymap_fix[] = {
+  0 /*CapsLock*/, PS2_F1, PS2_F2, PS2_F3, PS2_F4, PS2_F5, PS2_F6, PS2_F7,
+  PS2_F8, PS2_F9, PS2_F10, PS2_F11, PS2_F12, 0 /*PrtScr*/, PS2_SCROLL, 0 /*Pause*/,
+  PS2_INSERT, PS2_HOME, PS2_PAGEUP, PS2_DELETE, PS2_END, PS2_PAGEDOWN, PS2_RIGHTARROW, PS2_LEFTARROW,
+  PS2_DOWNARROW, PS2_UPARROW, 0 /*NumLock*/, '/', '*', '-', '+', PS2_ENTER,
+  PS2_END, PS2_DOWNARROW, PS2_PAGEDOWN, PS2_LEFTARROW, 0, PS2_RIGHTARROW, PS2_HOME, PS2_UPARROW,
+  PS2_PAGEUP, PS2_INSERT, PS2_DELETE };
+
+/* numeric keypad with numlock (HID usage 0x54..0x63) */
+#define PS2_NUMKEYMAP_FIRST   0x54
+static const uint8_t keymap_numon[] = {
+  '/', '*', '-', '+', PS2_ENTER, '1', '2', '3',
+  '4', '5', '6', '7', '8', '9', '0', '.' };
+
+#if KEYMAP_US == 1
+static const uint8_t keymap_us_noshift[PS2_KEYMAP_SIZE] = {
+  'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h',                               /* a..h */
+  'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p',                               /* i..p */
+  'q', 'r', 's', 't', 'u', 'v', 'w', 'x',                               /* q..x */
+  'y', 'z',                                                             /* y, z */
+  '1', '2', '3', '4', '5', '6', '7', '8', '9', '0',                     /* 1..0 */
+  PS2_ENTER, PS2_ESC, PS2_BACKSPACE, PS2_TAB, ' ',                      /* enter, esc, backspace, tab, space */
+  '-', '=', '[', ']', '\\', 0,                                          /* - = [ ] \ # */
+  ';', '\'', '`', ',', '.', '/',                                        /* ; ' ` , . / */
+  0 };                                                                  /* non-US \ */
+
+static const uint8_t keymap_us_shift[PS2_KEYMAP_SIZE] = {
+  'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H',                               /* a..h */
+  'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P',                               /* i..p */
+  'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X',                               /* q..x */
+  'Y', 'Z',                                                             /* y, z */
+  '!', '@', '#', '$', '%', '^', '&', '*', '(', ')',                     /* 1..0 */
+  PS2_ENTER, PS2_ESC, PS2_BACKSPACE, PS2_TAB, ' ',                      /* enter, esc, backspace, tab, space */
+  '_', '+', '{', '}', '|', 0,                                           /* - = [ ] \ # */
+  ':', '"', '~', '<', '>', '?',                                         /* ; ' ` , . / */
+  0 };                                                                  /* non-US \ */
+
+static const PS2Keymap_t keymap_us = {
+  keymap_us_noshift, keymap_us_shift, NULL,
+  {0xFF, 0xFF, 0xFF, 0x03, 0x00, 0x00, 0x00}, /* a..z */
+  NULL,
+  PS2_KEYMAP_UNICODE(NULL, NULL) };
+#endif
+
+#if KEYMAP_D == 1
+static const uint8_t keymap_d_noshift[PS2_KEYMAP_SIZE] = {
+  'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h',                               /* a..h */
+  'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p',                               /* i..p */
+  'q', 'r', 's', 't', 'u', 'v', 'w', 'x',                               /* q..x */
+  'z', 'y',                                                             /* y, z */
+  '1', '2', '3', '4', '5', '6', '7', '8', '9', '0',                     /* 1..0 */
+  PS2_ENTER, PS2_ESC, PS2_BACKSPACE, PS2_TAB, ' ',                      /* enter, esc, backspace, tab, space */
+  PS2_SHARP_S, PS2_ACUTE_ACCENT, PS2_u_DIAERESIS, '+', '#', '#',        /* - = [ ] \ # */
+  PS2_o_DIAERESIS, PS2_a_DIAERESIS, '^', ',', '.', '-',                 /* ; ' ` , . / */
+  '<' };                                                                /* non-US \ */
+
+static const uint8_t keymap_d_shift[PS2_KEYMAP_SIZE] = {
+  'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H',                               /* a..h */
+  'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P',                               /* i..p */
+  'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X',                               /* q..x */
+  'Z', 'Y',                                                             /* y, z */
+  '!', '"', PS2_SECTION_SIGN, '$', '%', '&', '/', '(', ')', '=',        /* 1..0 */
+  PS2_ENTER, PS2_ESC, PS2_BACKSPACE, PS2_TAB, ' ',                      /* enter, esc, backspace, tab, space */
+  '?', '`', PS2_U_DIAERESIS, '*', '\'', '\'',                           /* - = [ ] \ # */
+  PS2_O_DIAERESIS, PS2_A_DIAERESIS, PS2_DEGREE_SIGN, ';', ':', '_',     /* ; ' ` , . / */
+  '>' };                                                                /* non-US \ */
+
+static const uint8_t keymap_d_altgr[PS2_KEYMAP_SIZE] = {
+  0, 0, 0, 0, PS2_EURO_SIGN, 0, 0, 0,                                   /* a..h */
+  0, 0, 0, 0, PS2_MICRO_SIGN, 0, 0, 0,                                  /* i..p */
+  '@', 0, 0, 0, 0, 0, 0, 0,                                             /* q..x */
+  0, 0,                                                                 /* y, z */
+  0, PS2_SUPERSCRIPT_TWO, PS2_SUPERSCRIPT_THREE, 0, 0, 0, '{', '[', ']', '}', /* 1..0 */
+  PS2_ENTER, PS2_ESC, PS2_BACKSPACE, PS2_TAB, ' ',                      /* enter, esc, backspace, tab, space */
+  '\\', 0, 0, '~', 0, 0,                                                /* - = [ ] \ # */
+  0, 0, 0, 0, 0, 0,                                                     /* ; ' ` , . / */
+  '|' };                                                                /* non-US \ */
+
+#if KEYMAP_UNICODE == 1
+/* Windows-1252 0x80..0xFF -> unicode (0 = undefined) */
+static const uint16_t keymap_cp1252[128] = {
+  0x20AC, 0x0000, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,       /* 80 */
+  0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x0000, 0x017D, 0x0000,       /* 88 */
+  0x0000, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,       /* 90 */
+  0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x0000, 0x017E, 0x0178,       /* 98 */
+  0x00A0, 0x00A1, 0x00A2, 0x00A3, 0x00A4, 0x00A5, 0x00A6, 0x00A7,       /* A0 */
+  0x00A8, 0x00A9, 0x00AA, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x00AF,       /* A8 */
+  0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x00B4, 0x00B5, 0x00B6, 0x00B7,       /* B0 */
+  0x00B8, 0x00B9, 0x00BA, 0x00BB, 0x00BC, 0x00BD, 0x00BE, 0x00BF,       /* B8 */
+  0x00C0, 0x00C1, 0x00C2, 0x00C3, 0x00C4, 0x00C5, 0x00C6, 0x00C7,       /* C0 */
+  0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,       /* C8 */
+  0x00D0, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x00D7,       /* D0 */
+  0x00D8, 0x00D9, 0x00DA, 0x00DB, 0x00DC, 0x00DD, 0x00DE, 0x00DF,       /* D8 */
+  0x00E0, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x00E7,       /* E0 */
+  0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF,       /* E8 */
+  0x00F0, 0x00F1, 0x00F2, 0x00F3, 0x00F4, 0x00F5, 0x00F6, 0x00F7,       /* F0 */
+  0x00F8, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x00FD, 0x00FE, 0x00FF };     /* F8 */
+
+static const uint8_t keymap_d_deadkeys[] = {
+  '^', PS2_ACUTE_ACCENT, '`', 0 };
+#endif
+
+static const PS2Keymap_t keymap_d = {
+  keymap_d_noshift, keymap_d_shift, keymap_d_altgr,
+  {0xFF, 0xFF, 0xFF, 0x03, 0x00, 0x88, 0x01}, /* a..z, u/o/a diaeresis */
+  NULL,
+  PS2_KEYMAP_UNICODE(keymap_cp1252, keymap_d_deadkeys) };
+#endif
+
+#if KEYMAP_HU == 1
+static const uint8_t keymap_hu_noshift[PS2_KEYMAP_SIZE] = {
+  'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h',                               /* a..h */
+  'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p',                               /* i..p */
+  'q', 'r', 's', 't', 'u', 'v', 'w', 'x',                               /* q..x */
+  'z', 'y',                                                             /* y, z */
+  '1', '2', '3', '4', '5', '6', '7', '8', '9', PS2_o_DIAERESIS,         /* 1..0 */
+  PS2_ENTER, PS2_ESC, PS2_BACKSPACE, PS2_TAB, ' ',                      /* enter, esc, backspace, tab, space */
+  PS2_u_DIAERESIS, PS2_o_ACUTE, PS2_o_DOUBLE_ACUTE, PS2_u_ACUTE, PS2_u_DOUBLE_ACUTE, 0, /* - = [ ] \ # */
+  PS2_e_ACUTE, PS2_a_ACUTE, '0', ',', '.', '-',                         /* ; ' ` , . / */
+  PS2_i_ACUTE };                                                        /* non-US \ */
+
+static const uint8_t keymap_hu_shift[PS2_KEYMAP_SIZE] = {
+  'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H',                               /* a..h */
+  'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P',                               /* i..p */
+  'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X',                               /* q..x */
+  'Z', 'Y',                                                             /* y, z */
+  '\'', '"', '+', '!', '%', '/', '=', '(', ')', PS2_O_DIAERESIS,        /* 1..0 */
+  PS2_ENTER, PS2_ESC, PS2_BACKSPACE, PS2_TAB, ' ',                      /* enter, esc, backspace, tab, space */
+  PS2_U_DIAERESIS, PS2_O_ACUTE, PS2_O_DOUBLE_ACUTE, PS2_U_ACUTE, PS2_U_DOUBLE_ACUTE, 0, /* - = [ ] \ # */
+  PS2_E_ACUTE, PS2_A_ACUTE, PS2_SECTION_SIGN, '?', ':', '_',            /* ; ' ` , . / */
+  PS2_I_ACUTE };                                                        /* non-US \ */
+
+static const uint8_t keymap_hu_altgr[PS2_KEYMAP_SIZE] = {
+  PS2_a_DIAERESIS, '{', '&', PS2_D_STROKE, PS2_A_DIAERESIS, '[', ']', 'h', /* a..h */
+  'i', 'j', PS2_l_STROKE, PS2_L_STROKE, 'm', '}', 'o', 'p',             /* i..p */
+  '\\', 'r', PS2_d_STROKE, 't', PS2_EURO_SIGN, '@', '|', '#',           /* q..x */
+  'z', '>',                                                             /* y, z */
+  '~', PS2_CARON, '^', PS2_BREVE, PS2_DEGREE_SIGN, PS2_OGONEK, '`', PS2_DOT_ABOVE, PS2_ACUTE_ACCENT, PS2_DOUBLE_ACUTE, /* 1..0 */
+  PS2_ENTER, PS2_ESC, PS2_BACKSPACE, PS2_TAB, ' ',                      /* enter, esc, backspace, tab, space */
+  PS2_DIAERESIS, PS2_CEDILLA, PS2_DIVISION_SIGN, PS2_u_ACUTE, '\\', 0,  /* - = [ ] \ # */
+  '$', PS2_SHARP_S, '0', ';', '.', '*',                                 /* ; ' ` , . / */
+  '<' };                                                                /* non-US \ */
+
+#if KEYMAP_UNICODE == 1
+/* Windows-1250 0x80..0xFF -> unicode (0 = undefined) */
+static const uint16_t keymap_cp1250[128] = {
+  0x20AC, 0x0000, 0x201A, 0x0000, 0x201E, 0x2026, 0x2020, 0x2021,       /* 80 */
+  0x0000, 0x2030, 0x0160, 0x2039, 0x015A, 0x0164, 0x017D, 0x0179,       /* 88 */
+  0x0000, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,       /* 90 */
+  0x0000, 0x2122, 0x0161, 0x203A, 0x015B, 0x0165, 0x017E, 0x017A,       /* 98 */
+  0x00A0, 0x02C7, 0x02D8, 0x0141, 0x00A4, 0x0104, 0x00A6, 0x00A7,       /* A0 */
+  0x00A8, 0x00A9, 0x015E, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x017B,       /* A8 */
+  0x00B0, 0x00B1, 0x02DB, 0x0142, 0x00B4, 0x00B5, 0x00B6, 0x00B7,       /* B0 */
+  0x00B8, 0x0105, 0x015F, 0x00BB, 0x013D, 0x02DD, 0x013E, 0x017C,       /* B8 */
+  0x0154, 0x00C1, 0x00C2, 0x0102, 0x00C4, 0x0139, 0x0106, 0x00C7,       /* C0 */
+  0x010C, 0x00C9, 0x0118, 0x00CB, 0x011A, 0x00CD, 0x00CE, 0x010E,       /* C8 */
+  0x0110, 0x0143, 0x0147, 0x00D3, 0x00D4, 0x0150, 0x00D6, 0x00D7,       /* D0 */
+  0x0158, 0x016E, 0x00DA, 0x0170, 0x00DC, 0x00DD, 0x0162, 0x00DF,       /* D8 */
+  0x0155, 0x00E1, 0x00E2, 0x0103, 0x00E4, 0x013A, 0x0107, 0x00E7,       /* E0 */
+  0x010D, 0x00E9, 0x0119, 0x00EB, 0x011B, 0x00ED, 0x00EE, 0x010F,       /* E8 */
+  0x0111, 0x0144, 0x0148, 0x00F3, 0x00F4, 0x0151, 0x00F6, 0x00F7,       /* F0 */
+  0x0159, 0x016F, 0x00FA, 0x0171, 0x00FC, 0x00FD, 0x0163, 0x02D9 };     /* F8 */
+
+/* altgr + 1..0, altgr + u diaeresis, altgr + o acute */
+static const uint8_t keymap_hu_deadkeys[] = {
+  '~', PS2_CARON, '^', PS2_BREVE, PS2_DEGREE_SIGN, PS2_OGONEK, '`', PS2_DOT_ABOVE, PS2_ACUTE_ACCENT, PS2_DOUBLE_ACUTE,
+  PS2_DIAERESIS, PS2_CEDILLA, 0 };
 #endif
 
-#ifdef KEYMAP_HU
-const PS2Keymap_t keymap = {
-  // noshift
-  {0, PS2_F9, 0, PS2_F5, PS2_F3, PS2_F1, PS2_F2, PS2_F12,
-  0, PS2_F10, PS2_F8, PS2_F6, PS2_F4, PS2_TAB, '0', 0,
-  0, 0 /*Lalt*/, 0 /*Lshift*/, 0, 0 /*Lctrl*/, 'q', '1', 0,
-  0, 0, 'y', 's', 'a', 'w', '2', 0,
-  0, 'c', 'x', 'd', 'e', '4', '3', 0,
-  0, ' ', 'v', 'f', 't', 'r', '5', 0,
-  0, 'n', 'b', 'h', 'g', 'z', '6', 0,
-  0, 0, 'm', 'j', 'u', '7', '8', 0,
-  0, ',', 'k', 'i', 'o', '', '9', 0,
-  0, '.', '-', 'l', '', 'p', '', 0,
-  0, 0, '', 0, '', '', 0, 0,
-  0 /*CapsLock*/, 0 /*Rshift*/, PS2_ENTER /*Enter*/, '', 0, '\\', 0, 0,
-  0, '', 0, 0, 0, 0, PS2_BACKSPACE, 0},
-  // shift
-  {0, PS2_F9, 0, PS2_F5, PS2_F3, PS2_F1, PS2_F2, PS2_F12,
-  0, PS2_F10, PS2_F8, PS2_F6, PS2_F4, PS2_TAB, '', 0,
-  0, 0 /*Lalt*/, 0 /*Lshift*/, 0, 0 /*Lctrl*/, 'Q', '\'', 0,
-  0, 0, 'Y', 'S', 'A', 'W', '\"', 0,
-  0, 'C', 'X', 'D', 'E', '!', '+', 0,
-  0, ' ', 'V', 'F', 'T', 'R', '%', 0,
-  0, 'N', 'B', 'H', 'G', 'Z', '/', 0,
-  0, 0, 'M', 'J', 'U', '=', '(', 0,
-  0, '?', 'K', 'I', 'O', '', ')', 0,
-  0, ':', '_', 'L', '', 'P', '', 0,
-  0, 0, '', 0, '', '', 0, 0,
-  0 /*CapsLock*/, 0 /*Rshift*/, PS2_ENTER /*Enter*/, '', 0, '|', 0, 0,
-  0, '', 0, 0, 0, 0, PS2_BACKSPACE, 0},
-  // noshiftcaps
-  {0, PS2_F9, 0, PS2_F5, PS2_F3, PS2_F1, PS2_F2, PS2_F12,
-  0, PS2_F10, PS2_F8, PS2_F6, PS2_F4, PS2_TAB, '0', 0,
-  0, 0 /*Lalt*/, 0 /*Lshift*/, 0, 0 /*Lctrl*/, 'Q', '1', 0,
-  0, 0, 'Y', 'S', 'A', 'W', '2', 0,
-  0, 'C', 'X', 'D', 'E', '4', '3', 0,
-  0, ' ', 'V', 'F', 'T', 'R', '5', 0,
-  0, 'N', 'B', 'H', 'G', 'Z', '6', 0,
-  0, 0, 'M', 'J', 'U', '7', '8', 0,
-  0, ',', 'K', 'I', 'O', '', '9', 0,
-  0, '.', '-', 'L', '', 'P', '', 0,
-  0, 0, '', 0, '', '', 0, 0,
-  0 /*CapsLock*/, 0 /*Rshift*/, PS2_ENTER /*Enter*/, '', 0, '\\', 0, 0,
-  0, '', 0, 0, 0, 0, PS2_BACKSPACE, 0},
-  // shiftcaps
-  {0, PS2_F9, 0, PS2_F5, PS2_F3, PS2_F1, PS2_F2, PS2_F12,
-  0, PS2_F10, PS2_F8, PS2_F6, PS2_F4, PS2_TAB, '', 0,
-  0, 0 /*Lalt*/, 0 /*Lshift*/, 0, 0 /*Lctrl*/, 'q', '\'', 0,
-  0, 0, 'y', 's', 'a', 'w', '\"', 0,
-  0, 'c', 'x', 'd', 'e', '!', '+', 0,
-  0, ' ', 'v', 'f', 't', 'r', '%', 0,
-  0, 'n', 'b', 'h', 'g', 'z', '/', 0,
-  0, 0, 'm', 'j', 'u', '=', '(', 0,
-  0, '?', 'k', 'i', 'o', '', ')', 0,
-  0, ':', '_', 'l', '', 'p', '', 0,
-  0, 0, '', 0, '', '', 0, 0,
-  0 /*CapsLock*/, 0 /*Rshift*/, PS2_ENTER /*Enter*/, '', 0, '|', 0, 0,
-  0, '', 0, 0, 0, 0, PS2_BACKSPACE, 0},
-  // numoff
-  {0, PS2_END, 0, PS2_LEFTARROW, PS2_HOME, 0, 0, 0,
-  PS2_INSERT, PS2_DELETE, PS2_DOWNARROW, 0, PS2_LEFTARROW, PS2_UPARROW, PS2_ESC, 0 /*NumLock*/,
-  PS2_F11, '+', PS2_PAGEDOWN, '-', '*', PS2_PAGEUP, PS2_SCROLL, 0,
-  0, 0, 0, PS2_F7 },
-  // numon
-  {0, '1', 0, '4', '7', 0, 0, 0,
-  '0', '.', '2', '5', '6', '8', PS2_ESC, 0 /*NumLock*/,
-  PS2_F11, '+', '3', '-', '*', '9', PS2_SCROLL, 0,
-  0, 0, 0, PS2_F7 },
-  // uses_altgr
-  1,
-  // altgr
-  {0, PS2_F9, 0, PS2_F5, PS2_F3, PS2_F1, PS2_F2, PS2_F12,
-  0, PS2_F10, PS2_F8, PS2_F6, PS2_F4, PS2_TAB, '0', 0,
-  0, 0 /*Lalt*/, 0 /*Lshift*/, 0, 0 /*Lctrl*/, '\\', '~', 0,
-  0, 0, '>', '', '', '|', '', 0,
-  0, '&', '#', '', '', '', '^', 0,
-  0, ' ', '@', '[', 't', 'r', '', 0,
-  0, '}', '{', 'h', ']', 'z', '', 0,
-  0, 0, 'm', 'j', '', '`', '', 0,
-  0, ';', '', 'i', 'o', '', '', 0,
-  0, '.', '*', '', '$', 'p', '', 0,
-  0, 0, '', 0, '', '', 0, 0,
-  0 /*CapsLock*/, 0 /*Rshift*/, PS2_ENTER /*Enter*/, '', 0, '\\', 0, 0,
-  0, '<', 0, 0, 0, 0, PS2_BACKSPACE, 0}
-};
+static const PS2Keymap_t keymap_hu = {
+  keymap_hu_noshift, keymap_hu_shift, keymap_hu_altgr,
+  {0xFF, 0xFF, 0xFF, 0x03, 0x08, 0xBE, 0x21}, /* a..z, accented vowels */
+  NULL,
+  PS2_KEYMAP_UNICODE(keymap_cp1250, keymap_hu_deadkeys) };
 #endif
 
-#ifdef KEYMAP_D
-const PS2Keymap_t keymap = {
-  // without shift
-  {0, PS2_F9, 0, PS2_F5, PS2_F3, PS2_F1, PS2_F2, PS2_F12,
-  0, PS2_F10, PS2_F8, PS2_F6, PS2_F4, PS2_TAB, '^', 0,
-  0, 0 /*Lalt*/, 0 /*Lshift*/, 0, 0 /*Lctrl*/, 'q', '1', 0,
-  0, 0, 'y', 's', 'a', 'w', '2', 0,
-  0, 'c', 'x', 'd', 'e', '4', '3', 0,
-  0, ' ', 'v', 'f', 't', 'r', '5', 0,
-  0, 'n', 'b', 'h', 'g', 'z', '6', 0,
-  0, 0, 'm', 'j', 'u', '7', '8', 0,
-  0, ',', 'k', 'i', 'o', '0', '9', 0,
-  0, '.', '-', 'l', PS2_o_DIAERESIS, 'p', PS2_SHARP_S, 0,
-  0, 0, PS2_a_DIAERESIS, 0, PS2_u_DIAERESIS, '\'', 0, 0,
-  0 /*CapsLock*/, 0 /*Rshift*/, PS2_ENTER /*Enter*/, '+', 0, '#', 0, 0,
-  0, '<', 0, 0, 0, 0, PS2_BACKSPACE, 0,
-  0, '1', 0, '4', '7', 0, 0, 0,
-  '0', '.', '2', '5', '6', '8', PS2_ESC, 0 /*NumLock*/,
-  PS2_F11, '+', '3', '-', '*', '9', PS2_SCROLL, 0,
-  0, 0, 0, PS2_F7 },
-  // with shift
-  {0, PS2_F9, 0, PS2_F5, PS2_F3, PS2_F1, PS2_F2, PS2_F12,
-  0, PS2_F10, PS2_F8, PS2_F6, PS2_F4, PS2_TAB, PS2_DEGREE_SIGN, 0,
-  0, 0 /*Lalt*/, 0 /*Lshift*/, 0, 0 /*Lctrl*/, 'Q', '!', 0,
-  0, 0, 'Y', 'S', 'A', 'W', '"', 0,
-  0, 'C', 'X', 'D', 'E', '$', PS2_SECTION_SIGN, 0,
-  0, ' ', 'V', 'F', 'T', 'R', '%', 0,
-  0, 'N', 'B', 'H', 'G', 'Z', '&', 0,
-  0, 0, 'M', 'J', 'U', '/', '(', 0,
-  0, ';', 'K', 'I', 'O', '=', ')', 0,
-  0, ':', '_', 'L', PS2_O_DIAERESIS, 'P', '?', 0,
-  0, 0, PS2_A_DIAERESIS, 0, PS2_U_DIAERESIS, '`', 0, 0,
-  0 /*CapsLock*/, 0 /*Rshift*/, PS2_ENTER /*Enter*/, '*', 0, '\'', 0, 0,
-  0, '>', 0, 0, 0, 0, PS2_BACKSPACE, 0,
-  0, '1', 0, '4', '7', 0, 0, 0,
-  '0', '.', '2', '5', '6', '8', PS2_ESC, 0 /*NumLock*/,
-  PS2_F11, '+', '3', '-', '*', '9', PS2_SCROLL, 0,
-  0, 0, 0, PS2_F7 },
-  1,
-  // with altgr
-  {0, PS2_F9, 0, PS2_F5, PS2_F3, PS2_F1, PS2_F2, PS2_F12,
-  0, PS2_F10, PS2_F8, PS2_F6, PS2_F4, PS2_TAB, 0, 0,
-  0, 0 /*Lalt*/, 0 /*Lshift*/, 0, 0 /*Lctrl*/, '@', 0, 0,
-  0, 0, 0, 0, 0, 0, PS2_SUPERSCRIPT_TWO, 0,
-  0, 0, 0, 0, PS2_CURRENCY_SIGN, 0, PS2_SUPERSCRIPT_THREE, 0,
-  0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, PS2_MICRO_SIGN, 0, 0, '{', '[', 0,
-  0, 0, 0, 0, 0, '}', ']', 0,
-  0, 0, 0, 0, 0, 0, '\\', 0,
-  0, 0, 0, 0, 0, 0, 0, 0,
-  0 /*CapsLock*/, 0 /*Rshift*/, PS2_ENTER /*Enter*/, '~', 0, '#', 0, 0,
-  0, '|', 0, 0, 0, 0, PS2_BACKSPACE, 0,
-  0, '1', 0, '4', '7', 0, 0, 0,
-  '0', '.', '2', '5', '6', '8', PS2_ESC, 0 /*NumLock*/,
-  PS2_F11, '+', '3', '-', '*', '9', PS2_SCROLL, 0,
-  0, 0, 0, PS2_F7 }
-};
+#if (KEYMAP_UNICODE == 1) && ((KEYMAP_D == 1) || (KEYMAP_HU == 1))
+/* dead key compose table ({dead key unicode, base character, composed unicode}, ...)
+   - dead key + space -> the dead key character, dead key + not composable character -> both characters */
+static const uint16_t keymap_compose[][3] = {
+  {0x0060, 'A', 0x00C0}, {0x0060, 'a', 0x00E0}, {0x0060, 'E', 0x00C8}, {0x0060, 'e', 0x00E8}, /* grave */
+  {0x0060, 'I', 0x00CC}, {0x0060, 'i', 0x00EC}, {0x0060, 'O', 0x00D2}, {0x0060, 'o', 0x00F2},
+  {0x0060, 'U', 0x00D9}, {0x0060, 'u', 0x00F9},
+  {0x00B4, 'A', 0x00C1}, {0x00B4, 'a', 0x00E1}, {0x00B4, 'C', 0x0106}, {0x00B4, 'c', 0x0107}, /* acute */
+  {0x00B4, 'E', 0x00C9}, {0x00B4, 'e', 0x00E9}, {0x00B4, 'I', 0x00CD}, {0x00B4, 'i', 0x00ED},
+  {0x00B4, 'L', 0x0139}, {0x00B4, 'l', 0x013A}, {0x00B4, 'N', 0x0143}, {0x00B4, 'n', 0x0144},
+  {0x00B4, 'O', 0x00D3}, {0x00B4, 'o', 0x00F3}, {0x00B4, 'R', 0x0154}, {0x00B4, 'r', 0x0155},
+  {0x00B4, 'S', 0x015A}, {0x00B4, 's', 0x015B}, {0x00B4, 'U', 0x00DA}, {0x00B4, 'u', 0x00FA},
+  {0x00B4, 'Y', 0x00DD}, {0x00B4, 'y', 0x00FD}, {0x00B4, 'Z', 0x0179}, {0x00B4, 'z', 0x017A},
+  {0x005E, 'A', 0x00C2}, {0x005E, 'a', 0x00E2}, {0x005E, 'C', 0x0108}, {0x005E, 'c', 0x0109}, /* circumflex */
+  {0x005E, 'E', 0x00CA}, {0x005E, 'e', 0x00EA}, {0x005E, 'G', 0x011C}, {0x005E, 'g', 0x011D},
+  {0x005E, 'I', 0x00CE}, {0x005E, 'i', 0x00EE}, {0x005E, 'O', 0x00D4}, {0x005E, 'o', 0x00F4},
+  {0x005E, 'S', 0x015C}, {0x005E, 's', 0x015D}, {0x005E, 'U', 0x00DB}, {0x005E, 'u', 0x00FB},
+  {0x005E, 'Y', 0x0176}, {0x005E, 'y', 0x0177},
+  {0x007E, 'A', 0x00C3}, {0x007E, 'a', 0x00E3}, {0x007E, 'I', 0x0128}, {0x007E, 'i', 0x0129}, /* tilde */
+  {0x007E, 'N', 0x00D1}, {0x007E, 'n', 0x00F1}, {0x007E, 'O', 0x00D5}, {0x007E, 'o', 0x00F5},
+  {0x007E, 'U', 0x0168}, {0x007E, 'u', 0x0169},
+  {0x00A8, 'A', 0x00C4}, {0x00A8, 'a', 0x00E4}, {0x00A8, 'E', 0x00CB}, {0x00A8, 'e', 0x00EB}, /* diaeresis */
+  {0x00A8, 'I', 0x00CF}, {0x00A8, 'i', 0x00EF}, {0x00A8, 'O', 0x00D6}, {0x00A8, 'o', 0x00F6},
+  {0x00A8, 'U', 0x00DC}, {0x00A8, 'u', 0x00FC}, {0x00A8, 'Y', 0x0178}, {0x00A8, 'y', 0x00FF},
+  {0x00B0, 'A', 0x00C5}, {0x00B0, 'a', 0x00E5}, {0x00B0, 'U', 0x016E}, {0x00B0, 'u', 0x016F}, /* ring (degree sign) */
+  {0x02C7, 'C', 0x010C}, {0x02C7, 'c', 0x010D}, {0x02C7, 'D', 0x010E}, {0x02C7, 'd', 0x010F}, /* caron */
+  {0x02C7, 'E', 0x011A}, {0x02C7, 'e', 0x011B}, {0x02C7, 'L', 0x013D}, {0x02C7, 'l', 0x013E},
+  {0x02C7, 'N', 0x0147}, {0x02C7, 'n', 0x0148}, {0x02C7, 'R', 0x0158}, {0x02C7, 'r', 0x0159},
+  {0x02C7, 'S', 0x0160}, {0x02C7, 's', 0x0161}, {0x02C7, 'T', 0x0164}, {0x02C7, 't', 0x0165},
+  {0x02C7, 'Z', 0x017D}, {0x02C7, 'z', 0x017E},
+  {0x02D8, 'A', 0x0102}, {0x02D8, 'a', 0x0103}, {0x02D8, 'E', 0x0114}, {0x02D8, 'e', 0x0115}, /* breve */
+  {0x02D8, 'G', 0x011E}, {0x02D8, 'g', 0x011F}, {0x02D8, 'I', 0x012C}, {0x02D8, 'i', 0x012D},
+  {0x02D8, 'O', 0x014E}, {0x02D8, 'o', 0x014F}, {0x02D8, 'U', 0x016C}, {0x02D8, 'u', 0x016D},
+  {0x02D9, 'C', 0x010A}, {0x02D9, 'c', 0x010B}, {0x02D9, 'E', 0x0116}, {0x02D9, 'e', 0x0117}, /* dot above */
+  {0x02D9, 'G', 0x0120}, {0x02D9, 'g', 0x0121}, {0x02D9, 'I', 0x0130}, {0x02D9, 'Z', 0x017B},
+  {0x02D9, 'z', 0x017C},
+  {0x02DD, 'O', 0x0150}, {0x02DD, 'o', 0x0151}, {0x02DD, 'U', 0x0170}, {0x02DD, 'u', 0x0171}, /* double acute */
+  {0x00B8, 'C', 0x00C7}, {0x00B8, 'c', 0x00E7}, {0x00B8, 'G', 0x0122}, {0x00B8, 'g', 0x0123}, /* cedilla */
+  {0x00B8, 'L', 0x013B}, {0x00B8, 'l', 0x013C}, {0x00B8, 'N', 0x0145}, {0x00B8, 'n', 0x0146},
+  {0x00B8, 'R', 0x0156}, {0x00B8, 'r', 0x0157}, {0x00B8, 'S', 0x015E}, {0x00B8, 's', 0x015F},
+  {0x00B8, 'T', 0x0162}, {0x00B8, 't', 0x0163},
+  {0x02DB, 'A', 0x0104}, {0x02DB, 'a', 0x0105}, {0x02DB, 'E', 0x0118}, {0x02DB, 'e', 0x0119}, /* ogonek */
+  {0x02DB, 'I', 0x012E}, {0x02DB, 'i', 0x012F}, {0x02DB, 'U', 0x0172}, {0x02DB, 'u', 0x0173} };
 #endif
 
 #endif  /* #if ((defined PS2_KBDCLK) && defined PS2_KBDDATA)) */